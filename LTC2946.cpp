@@ -5,7 +5,7 @@ Revised Version
 Reformatted code into a single class, capable of functioning with Teensy 3.6.
 
 -Has full functionality for continuous read of VIN, Current and Power.
--Has limited functionality for Snapshot mode (VIN, Current) (to be done in future if time permits)
+-Has functionality for Snapshot mode (VIN, Current, and Power computed from back-to-back conversions)
 -Incorporated experimentally determined constants (one constant to correlate measured with actual value).
 -No limit functionality at this time.
 -I2C error transaction checking via a single function to check and clear past errors (use in an if statement)
@@ -31,29 +31,57 @@ Shutdown mode reduces power consumption to 15uA.
 */
 
 
-#include <Arduino.h>
 #include <stdint.h>
+#include <string.h>
 #include "LTC2946.h"
-#include <i2c_t3.h>
-//#include <Wire.h>
+#include "LTC2946_Trace.h"
+
+//! Shadowed configuration registers as contiguous {first register, length} ranges:
+//! CTRLA-ALERT1, power thresholds, delta sense thresholds, VIN thresholds, ADIN thresholds-ALERT2-GPIO_CFG, GPIO3_CTRL-CLK_DIV
+const uint8_t LTC2946::config_range[LTC2946_CONFIG_RANGES][2] = {
+    {LTC2946_CTRLA_REG, 3},
+    {LTC2946_MAX_POWER_THRESHOLD_MSB2_REG, 6},
+    {LTC2946_MAX_DELTA_SENSE_THRESHOLD_MSB_REG, 4},
+    {LTC2946_MAX_VIN_THRESHOLD_MSB_REG, 4},
+    {LTC2946_MAX_ADIN_THRESHOLD_MSB_REG, 6},
+    {LTC2946_GPIO3_CTRL_REG, 2}
+};
+
+//! Delta sense conversions per continuous-mode frame, by CTRLA[2:0]
+const uint8_t LTC2946::current_count[LTC2946_CHANNEL_CONFIG_SNAPSHOT] = {1, 15, 127, 1, 30, 254, 1};
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include "LTC2946_Wire.h"
+
+LTC2946 *LTC2946::snapshot_isr_owner[LTC2946_SNAPSHOT_ALERT_PINS] = {NULL, NULL, NULL, NULL};
+
+void LTC2946::SnapshotIsr0() {snapshot_isr_owner[0]->SnapshotDone();}
+void LTC2946::SnapshotIsr1() {snapshot_isr_owner[1]->SnapshotDone();}
+void LTC2946::SnapshotIsr2() {snapshot_isr_owner[2]->SnapshotDone();}
+void LTC2946::SnapshotIsr3() {snapshot_isr_owner[3]->SnapshotDone();}
 
 LTC2946::LTC2946(uint8_t wire_num,uint8_t wire_addr) //!constructor
 {
-    I2C_WIRE = wire_num;
+    I2C_BUS = &LTC2946_Wire::Get(wire_num);
+    I2C_ADDRESS = wire_addr;
+    PowerOnImage(shadow);
+}
+#endif
+
+LTC2946::LTC2946(LTC2946_Bus &bus,uint8_t wire_addr) //!constructor
+{
+    I2C_BUS = &bus;
     I2C_ADDRESS = wire_addr;
+    PowerOnImage(shadow);
 }
 
 void LTC2946::Setup()
 {
-    if(I2C_WIRE == 0){
-        Wire.begin();
-    }else if(I2C_WIRE == 1){
-        Wire1.begin();
-    }else if(I2C_WIRE == 2){
-        Wire2.begin();
-    }else if(I2C_WIRE == 3){
-        Wire3.begin();
-    }
+#if defined(LTC2946_TRACE)
+    LTC2946_Trace::Begin();
+#endif
+    I2C_BUS->Begin();
 }
 
 bool LTC2946::ErrorCheck()
@@ -88,6 +116,13 @@ void LTC2946::SetSnapShot()
     LTC2946_mode = 1;
 }
 
+bool LTC2946::SetSnapshotVIN(uint8_t channel)
+{
+    if(channel != LTC2946_SENSE_PLUS && channel != LTC2946_VDD) return(false);
+    snapshot_vin = channel;
+    return(true);
+}
+
 void LTC2946::EnableConversion(bool state)
 {
     use_conversion = state;
@@ -112,39 +147,12 @@ float LTC2946::ReadVIN()
     //Snapshot Request
     else if(LTC2946_mode == 1)
     {
-        int8_t LTC2946_mode;
-        LTC2946_mode = LTC2946_CHANNEL_CONFIG_SNAPSHOT | LTC2946_VDD;
-        ack |= LTC2946_write(LTC2946_CTRLA_REG, LTC2946_mode);
-
-        uint8_t busy;
-        do
-        {
-            ack |= LTC2946_read(LTC2946_STATUS2_REG, &busy);
-        }
-        while (0x8 & busy);
-
-        ack |= LTC2946_read_12_bits(LTC2946_VIN_MSB_REG, &VIN_code);
+        //Trigger, wait out the conversion, read the result (errors land in ErrorCheck())
+        VIN_code = LTC2946_snapshot(snapshot_vin);
     }
 
     //Conversion
-    if(use_conversion)
-    {
-        if(use_legacy)
-        {
-            //Legacy conversion
-            VIN_Return = LTC2946_VIN_code_to_voltage(VIN_code);
-        }
-        else
-        {
-            //Experimental conversion
-            VIN_Return = (float)VIN_code*VIN_CONST;
-        }
-    }
-    else
-    {
-        //Return RAW value
-        VIN_Return = (float)VIN_code;
-    }
+    VIN_Return = ConvertVIN(VIN_code);
 
     //update error
     I2C_ACK |= ack;
@@ -166,39 +174,12 @@ float LTC2946::ReadCurrent()
     //Snapshot Request
     else if(LTC2946_mode == 1)
     {
-        int8_t LTC2946_mode;
-        LTC2946_mode = LTC2946_CHANNEL_CONFIG_SNAPSHOT | LTC2946_DELTA_SENSE;
-        ack |= LTC2946_write(LTC2946_CTRLA_REG, LTC2946_mode);
-
-        uint8_t busy;
-        do
-        {
-            ack |= LTC2946_read(LTC2946_STATUS2_REG, &busy);        //!< Check to see if conversion is still in process
-        }
-        while (0x8 & busy);
-
-        ack |= LTC2946_read_12_bits(LTC2946_DELTA_SENSE_MSB_REG, &current_code);
+        //Trigger, wait out the conversion, read the result (errors land in ErrorCheck())
+        current_code = LTC2946_snapshot(LTC2946_DELTA_SENSE);
     }
 
     //Conversion
-    if(use_conversion)
-    {
-        if(use_legacy)
-        {
-            //Legacy conversion
-            current_Return = LTC2946_code_to_current(current_code);
-        }
-        else
-        {
-            //Experimental conversion
-            current_Return = (float)current_code*CURRENT_CONST;
-        }
-    }
-    else
-    {
-        //Return RAW value
-        current_Return = (float)current_code;
-    }
+    current_Return = ConvertCurrent(current_code);
 
     //update error
     I2C_ACK |= ack;
@@ -209,7 +190,7 @@ float LTC2946::ReadCurrent()
 float LTC2946::ReadPower()
 {
     int8_t ack = 0;
-    uint32_t power_code;
+    uint32_t power_code = 0;
     float power_Return = 0;
 
     //Continuous Request
@@ -220,560 +201,1101 @@ float LTC2946::ReadPower()
     //Snapshot Request
     else if(LTC2946_mode == 1)
     {
-        //Not available Yet
+        uint16_t VIN_code, current_code;
+
+        //Power formed in software from back-to-back conversions (errors land in ErrorCheck())
+        LTC2946_snapshot_power(&VIN_code, &current_code, &power_code);
     }
 
     //Conversion
-    if(use_conversion)
+    power_Return = ConvertPower(power_code);
+
+    //update error
+    I2C_ACK |= ack;
+
+    return(power_Return);
+}
+
+void LTC2946::ReadSnapshotAll(LTC2946_Measurement *data)
+{
+    memset(data, 0, sizeof(*data));
+
+    LTC2946_snapshot_power(&data->vin_code, &data->delta_sense_code, &data->power_code);
+    data->vin = ConvertVIN(data->vin_code);
+    data->current = ConvertCurrent(data->delta_sense_code);
+    data->power = ConvertPower(data->power_code);
+}
+
+bool LTC2946::TriggerSnapshot(uint8_t channel)
+{
+    uint32_t conversion_us;
+    int8_t ack;
+
+    snapshot_state = LTC2946_SNAPSHOT_IDLE;
+    snapshot_channel = channel;
+    snapshot_status_reads = 0;
+
+    //Count the conversion from the start of the write: a STATUS2 read takes longer than the write, so the first
+    //read still samples the bit after the conversion has ended, and the write time is not added to the latency
+    snapshot_start_us = I2C_BUS->Micros();
+    ack = LTC2946_write(LTC2946_CTRLA_REG, LTC2946_CHANNEL_CONFIG_SNAPSHOT | channel);
+    //update error
+    I2C_ACK |= ack;
+    if(ack != LTC2946_OK)
     {
-        if(use_legacy)
+        snapshot_state = LTC2946_SNAPSHOT_FAILED;
+        return(false);
+    }
+
+    //Release ALERT from the previous conversion while this one runs, off the latency path
+    if(snapshot_alert) I2C_ACK |= LTC2946_write(LTC2946_FAULT2_REG, 0);
+
+    //The first STATUS2 read is due when the conversion should have finished. With the
+    //ADC-done alert it is only a fallback for a lost edge, one conversion time later.
+    conversion_us = (channel == LTC2946_DELTA_SENSE) ? LTC2946_CURRENT_CONV_US : LTC2946_VOLTAGE_CONV_US;
+    snapshot_poll_us = snapshot_start_us + (snapshot_alert ? 2 * conversion_us : conversion_us);
+    snapshot_state = LTC2946_SNAPSHOT_PENDING;
+    return(true);
+}
+
+uint8_t LTC2946::PollSnapshot()
+{
+    uint32_t now;
+    uint8_t status2;
+    int8_t ack;
+
+    if(snapshot_state != LTC2946_SNAPSHOT_PENDING) return(snapshot_state);
+
+    now = I2C_BUS->Micros();
+    if((int32_t)(now - snapshot_poll_us) < 0) return(snapshot_state);
+
+    ack = LTC2946_read(LTC2946_STATUS2_REG, &status2);
+    snapshot_status_reads++;
+    //update error
+    I2C_ACK |= ack;
+
+    if(ack != LTC2946_OK) snapshot_state = LTC2946_SNAPSHOT_FAILED;
+    else if(!(status2 & LTC2946_STATUS2_ADC_BUSY)) SnapshotDone();
+    else snapshot_poll_us = I2C_BUS->Micros() + LTC2946_SNAPSHOT_POLL_US;
+
+    return(snapshot_state);
+}
+
+void LTC2946::SnapshotDone()
+{
+    if(snapshot_state != LTC2946_SNAPSHOT_PENDING) return;
+
+    snapshot_ready_us = I2C_BUS->Micros();
+    snapshot_state = LTC2946_SNAPSHOT_READY;
+}
+
+uint8_t LTC2946::SnapshotState()
+{
+    return(snapshot_state);
+}
+
+uint16_t LTC2946::ReadSnapshot()
+{
+    uint16_t code = 0;
+
+    if(snapshot_state != LTC2946_SNAPSHOT_READY) return(0);
+
+    //update error
+    I2C_ACK |= LTC2946_read_12_bits(LTC2946_result_reg(snapshot_channel), &code);
+
+    LTC2946_snapshot_finish();
+    return(code);
+}
+
+void LTC2946::GetSnapshotStats(LTC2946_SnapshotStats *stats)
+{
+    *stats = snapshot_stats;
+}
+
+void LTC2946::ClearSnapshotStats()
+{
+    memset(&snapshot_stats, 0, sizeof(snapshot_stats));
+}
+
+bool LTC2946::EnableSnapshotAlert(uint8_t alert_pin)
+{
+    uint8_t config[2];
+    uint8_t slot = LTC2946_SNAPSHOT_ALERT_PINS;
+    int8_t ack;
+#if defined(ARDUINO)
+    static void (* const isr[LTC2946_SNAPSHOT_ALERT_PINS])(void) = {SnapshotIsr0, SnapshotIsr1, SnapshotIsr2, SnapshotIsr3};
+
+    for(slot = 0; slot < LTC2946_SNAPSHOT_ALERT_PINS; slot++)
+    {
+        if(snapshot_isr_owner[slot] == NULL || snapshot_isr_owner[slot] == this) break;
+    }
+#endif
+
+    //Find the interrupt slot before touching the device, so a refusal leaves it as it was
+    if(alert_pin != LTC2946_SNAPSHOT_NO_PIN && slot == LTC2946_SNAPSHOT_ALERT_PINS) return(false);
+
+    //ALERT2 and GPIO_CFG are adjacent: one write sets both
+    config[0] = (shadow[LTC2946_ALERT2_REG] & LTC2946_DISABLE_ADC_DONE_ALERT) | LTC2946_ENABLE_ADC_DONE_ALERT;
+    config[1] = (shadow[LTC2946_GPIO_CFG_REG] & LTC2946_GPIOCFG_GPIO3_MASK) | LTC2946_GPIO3_OUT_ALERT;
+    ack = LTC2946_write_block(LTC2946_ALERT2_REG, config, 2);
+    //update error
+    I2C_ACK |= ack;
+    if(ack != LTC2946_OK) return(false);
+
+    snapshot_alert = true;
+    if(alert_pin == LTC2946_SNAPSHOT_NO_PIN) return(true);
+
+#if defined(ARDUINO)
+    snapshot_isr_owner[slot] = this;
+    snapshot_pin = alert_pin;
+    pinMode(alert_pin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(alert_pin), isr[slot], FALLING);
+#endif
+    return(true);
+}
+
+void LTC2946::DisableSnapshotAlert()
+{
+#if defined(ARDUINO)
+    uint8_t i;
+
+    if(snapshot_pin != LTC2946_SNAPSHOT_NO_PIN)
+    {
+        detachInterrupt(digitalPinToInterrupt(snapshot_pin));
+        for(i = 0; i < LTC2946_SNAPSHOT_ALERT_PINS; i++)
         {
-            //Legacy conversion
-            //Not available yet
+            if(snapshot_isr_owner[i] == this) snapshot_isr_owner[i] = NULL;
         }
-        else
+    }
+#endif
+    snapshot_pin = LTC2946_SNAPSHOT_NO_PIN;
+    snapshot_alert = false;
+    UpdateConfig(LTC2946_ALERT2_REG, LTC2946_DISABLE_ADC_DONE_ALERT, 0);
+}
+
+bool LTC2946::StartSnapshotSequence(const uint8_t *channels, uint8_t count)
+{
+    uint8_t i, j;
+
+    if(count == 0 || count > LTC2946_SEQUENCE_MAX_CHANNELS) return(false);
+
+    //Every channel needs a result register of its own: a result is read while the next channel converts
+    for(i = 0; i < count; i++)
+    {
+        for(j = 0; j < i; j++)
         {
-            //Experimental conversion
-            power_Return = (float)power_code*POWER_CONST;
+            if(LTC2946_result_reg(channels[i]) == LTC2946_result_reg(channels[j])) return(false);
         }
+        sequence_channels[i] = channels[i];
     }
-    else
+
+    memset(sequence_codes, 0, sizeof(sequence_codes));
+    sequence_count = count;
+    sequence_next = 0;
+    sequence_failed = false;
+    sequence_state = LTC2946_SNAPSHOT_PENDING;
+
+    if(!TriggerSnapshot(sequence_channels[0]))
     {
-        //Return RAW value
-        power_Return = (float)power_code;
+        LTC2946_sequence_end(false);
+        return(false);
+    }
+    return(true);
+}
+
+uint8_t LTC2946::PollSnapshotSequence()
+{
+    uint8_t state, done;
+
+    if(sequence_state != LTC2946_SNAPSHOT_PENDING) return(sequence_state);
+
+    state = PollSnapshot();
+    if(state == LTC2946_SNAPSHOT_PENDING) return(sequence_state);
+    if(state != LTC2946_SNAPSHOT_READY)
+    {
+        LTC2946_sequence_end(false);
+        return(sequence_state);
+    }
+
+    //The result stays latched in its register: start the next channel first, then read it while that one converts
+    LTC2946_snapshot_finish();
+    done = sequence_next++;
+    if(sequence_next < sequence_count && !TriggerSnapshot(sequence_channels[sequence_next]))
+    {
+        LTC2946_sequence_end(false);
+        return(sequence_state);
     }
 
     //update error
-    I2C_ACK |= ack;
+    I2C_ACK |= LTC2946_read_12_bits(LTC2946_result_reg(sequence_channels[done]), &sequence_codes[done]);
+    if(LastStatus() != LTC2946_OK) sequence_failed = true;
 
-    return(power_Return);
+    if(sequence_next == sequence_count) LTC2946_sequence_end(!sequence_failed);
+    return(sequence_state);
 }
 
+uint16_t LTC2946::SequenceCode(uint8_t index)
+{
+    return((index < sequence_count) ? sequence_codes[index] : 0);
+}
 
+bool LTC2946::ReadSnapshotSequence(const uint8_t *channels, uint8_t count, uint16_t *codes)
+{
+    uint32_t now;
+    uint8_t i;
 
+    if(!StartSnapshotSequence(channels, count)) return(false);
 
-/*
-Here is where I would add provisions for limits and colombs and joules, if I ever find time for that
-*/
+    while(PollSnapshotSequence() == LTC2946_SNAPSHOT_PENDING)
+    {
+        now = I2C_BUS->Micros();
+        if((int32_t)(snapshot_poll_us - now) > 0) I2C_BUS->Delay(snapshot_poll_us - now);
+    }
 
+    for(i = 0; i < count; i++) codes[i] = sequence_codes[i];
+    return(sequence_state == LTC2946_SNAPSHOT_READY);
+}
 
+// Finish the sequence: CTRLA back to its configured value
+void LTC2946::LTC2946_sequence_end(bool ok)
+{
+    //One write restores the mode, none if no trigger replaced it
+    if(ctrla_triggered) WriteConfig(LTC2946_CTRLA_REG, shadow[LTC2946_CTRLA_REG]);
 
+    sequence_state = ok ? LTC2946_SNAPSHOT_READY : LTC2946_SNAPSHOT_FAILED;
+}
 
+// Book a finished snapshot in the counters and return to idle
+void LTC2946::LTC2946_snapshot_finish()
+{
+    snapshot_stats.snapshots++;
+    snapshot_stats.status_reads += snapshot_status_reads;
+    snapshot_stats.last_status_reads = snapshot_status_reads;
+    if(snapshot_status_reads > snapshot_stats.max_status_reads) snapshot_stats.max_status_reads = snapshot_status_reads;
+    snapshot_stats.last_conversion_us = snapshot_ready_us - snapshot_start_us;
 
+    snapshot_state = LTC2946_SNAPSHOT_IDLE;
+}
 
-// Write an 8-bit code to the LTC2946.
-int8_t LTC2946::LTC2946_write(uint8_t adc_command, uint8_t code)
-// The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+uint8_t LTC2946::LTC2946_result_reg(uint8_t channel)
 {
-    int8_t ack;
+    return((channel == LTC2946_DELTA_SENSE) ? LTC2946_DELTA_SENSE_MSB_REG :
+           (channel == LTC2946_ADIN) ? LTC2946_ADIN_MSB_REG : LTC2946_VIN_MSB_REG);
+}
 
-//  ack = i2c_write_byte_data(i2c_address, adc_command, code);
+// Snapshot VIN then delta sense and multiply the codes, as the device does for POWER in continuous mode
+void LTC2946::LTC2946_snapshot_power(uint16_t *vin_code, uint16_t *current_code, uint32_t *power_code)
+{
+    uint32_t vin_start_us;
+    bool ok;
+
+    *vin_code = LTC2946_snapshot(snapshot_vin);
+    ok = (LastStatus() == LTC2946_OK);
+    vin_start_us = snapshot_start_us;
+    *current_code = LTC2946_snapshot(LTC2946_DELTA_SENSE);
+    ok = ok && (LastStatus() == LTC2946_OK);
+
+    //Midpoint of the delta sense conversion to midpoint of the VIN conversion, both timed from their CTRLA writes
+    snapshot_stats.last_power_skew_us = ok ? snapshot_start_us - vin_start_us + (LTC2946_CURRENT_CONV_US - LTC2946_VOLTAGE_CONV_US) / 2 : 0;
+    *power_code = (uint32_t)*vin_code * *current_code;
+}
 
-    if(I2C_WIRE == 0){
-        Wire.beginTransmission(I2C_ADDRESS);
-        Wire.write(adc_command);
+// Blocking snapshot: sleeps through the conversion instead of reading STATUS2 back to back
+uint16_t LTC2946::LTC2946_snapshot(uint8_t channel)
+{
+    uint32_t now;
 
-        Wire.write(code);
-        ack = Wire.endTransmission(false);
-    }else if(I2C_WIRE == 1){
-        Wire1.beginTransmission(I2C_ADDRESS);
-        Wire1.write(adc_command);
+    if(!TriggerSnapshot(channel)) return(0);
 
-        Wire1.write(code);
-        ack = Wire1.endTransmission(false);
-    }else if(I2C_WIRE == 2){
-        Wire2.beginTransmission(I2C_ADDRESS);
-        Wire2.write(adc_command);
+    while(PollSnapshot() == LTC2946_SNAPSHOT_PENDING)
+    {
+        now = I2C_BUS->Micros();
+        if((int32_t)(snapshot_poll_us - now) > 0) I2C_BUS->Delay(snapshot_poll_us - now);
+    }
+    return(ReadSnapshot());
+}
 
-        Wire2.write(code);
-        ack = Wire2.endTransmission(false);
-    }else if(I2C_WIRE == 3){
-        Wire3.beginTransmission(I2C_ADDRESS);
-        Wire3.write(adc_command);
+void LTC2946::ReadAll(LTC2946_Measurement *data, uint8_t *reg_map)
+{
+    int8_t ack = 0;
+    uint8_t block[LTC2946_MEAS_BLOCK_LEN];
 
-        Wire3.write(code);
-        ack = Wire3.endTransmission(false);
+    if(reg_map != NULL)
+    {
+        //Full register map, measurement block decoded in place
+        ack |= LTC2946_read_block(LTC2946_CTRLA_REG, reg_map, LTC2946_REG_COUNT);
+        DecodeAll(&reg_map[LTC2946_MEAS_BLOCK_START], data);
+    }
+    else
+    {
+        ack |= LTC2946_read_block(LTC2946_MEAS_BLOCK_START, block, LTC2946_MEAS_BLOCK_LEN);
+        DecodeAll(block, data);
     }
 
-    return ack;
+    //update error
+    I2C_ACK |= ack;
+}
 
+void LTC2946::WriteConfig(uint8_t adc_command, uint8_t code)
+{
+    //update error
+    I2C_ACK |= LTC2946_write(adc_command, code);
 }
 
-// Write a 16-bit code to the LTC2946.
-int8_t LTC2946::LTC2946_write_16_bits(uint8_t adc_command, uint16_t code)
-// The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+void LTC2946::UpdateConfig(uint8_t adc_command, uint8_t mask, uint8_t bits)
 {
-  int8_t ack;
+    //Field update from the shadow: one write, no read-back
+    WriteConfig(adc_command, (shadow[adc_command] & mask) | bits);
+}
 
-  union
-  {
-    uint8_t b[2];
-    uint16_t w;
-  } data;
+uint8_t LTC2946::ReadConfig(uint8_t adc_command)
+{
+    return(shadow[adc_command]);
+}
 
-  data.w = code;
+void LTC2946::SetThresholds(const LTC2946_Thresholds *thresholds)
+{
+    StageThresholds(thresholds);
+    Commit();
+}
 
-//  ack = i2c_write_word_data(i2c_address, adc_command, code);
+void LTC2946::WriteBlock(uint8_t adc_command, const uint8_t *block, uint8_t len)
+{
+    //update error
+    I2C_ACK |= LTC2946_write_block(adc_command, block, len);
+}
 
-    if(I2C_WIRE == 0){
-        Wire.beginTransmission(I2C_ADDRESS);
-        Wire.write(adc_command);
+void LTC2946::StageConfig(uint8_t adc_command, uint8_t code)
+{
+    if(adc_command >= LTC2946_REG_COUNT) return;
+
+    staged[adc_command] = code;
+    dirty[adc_command / 8] |= 1 << (adc_command % 8);
+}
+
+void LTC2946::StageField(uint8_t adc_command, uint8_t mask, uint8_t bits)
+{
+    if(adc_command >= LTC2946_REG_COUNT) return;
+
+    StageConfig(adc_command, ((Dirty(adc_command) ? staged[adc_command] : shadow[adc_command]) & mask) | bits);
+}
 
-        Wire.write(data.b[1]);
-        Wire.write(data.b[0]);
-        ack = Wire.endTransmission(false);
-    }else if(I2C_WIRE == 1){
-        Wire1.beginTransmission(I2C_ADDRESS);
-        Wire1.write(adc_command);
+void LTC2946::StageThresholds(const LTC2946_Thresholds *thresholds)
+{
+    #define STAGE_24(reg, code) StageConfig(reg, (code) >> 16); StageConfig((reg) + 1, (code) >> 8); StageConfig((reg) + 2, code)
+    #define STAGE_12(reg, code) StageConfig(reg, (code) >> 4); StageConfig((reg) + 1, (code) << 4)
+
+    STAGE_24(LTC2946_MAX_POWER_THRESHOLD_MSB2_REG, thresholds->max_power);
+    STAGE_24(LTC2946_MIN_POWER_THRESHOLD_MSB2_REG, thresholds->min_power);
+
+    //12-bit thresholds are left justified in their register pair
+    STAGE_12(LTC2946_MAX_DELTA_SENSE_THRESHOLD_MSB_REG, thresholds->max_delta_sense);
+    STAGE_12(LTC2946_MIN_DELTA_SENSE_THRESHOLD_MSB_REG, thresholds->min_delta_sense);
+    STAGE_12(LTC2946_MAX_VIN_THRESHOLD_MSB_REG, thresholds->max_vin);
+    STAGE_12(LTC2946_MIN_VIN_THRESHOLD_MSB_REG, thresholds->min_vin);
+    STAGE_12(LTC2946_MAX_ADIN_THRESHOLD_MSB_REG, thresholds->max_adin);
+    STAGE_12(LTC2946_MIN_ADIN_THRESHOLD_MSB_REG, thresholds->min_adin);
+
+    #undef STAGE_24
+    #undef STAGE_12
+}
+
+uint16_t LTC2946::Commit()
+// Returns the bus bytes saved compared with writing each dirty register in its own transaction
+{
+    int8_t ack = 0, run_ack;
+    uint16_t single_bytes = 0, commit_bytes = 0;
+    uint8_t block[LTC2946_REG_COUNT];
+    uint8_t reg, first, last, next;
+    int8_t range;
+
+    reg = 0;
+    while(reg < LTC2946_REG_COUNT)
+    {
+        if(!Dirty(reg))
+        {
+            reg++;
+            continue;
+        }
 
-        Wire1.write(data.b[1]);
-        Wire1.write(data.b[0]);
-        ack = Wire1.endTransmission(false);
-    }else if(I2C_WIRE == 2){
-        Wire2.beginTransmission(I2C_ADDRESS);
-        Wire2.write(adc_command);
+        //Grow the run while the next dirty register is close enough that rewriting the clean ones
+        //in between (from the shadow) costs no more than a new transaction's address and command bytes.
+        //Gaps are only bridged inside one configuration range, never over measurement registers.
+        first = last = reg;
+        range = ConfigRange(first);
+        for(next = last + 1; next < LTC2946_REG_COUNT && next - last <= LTC2946_COMMIT_MAX_GAP + 1; next++)
+        {
+            if(!Dirty(next)) continue;
+            if(next == last + 1 || (range >= 0 && ConfigRange(next) == range)) last = next;
+            else break;
+        }
 
-        Wire2.write(data.b[1]);
-        Wire2.write(data.b[0]);
-        ack = Wire2.endTransmission(false);
-    }else if(I2C_WIRE == 3){
-        Wire3.beginTransmission(I2C_ADDRESS);
-        Wire3.write(adc_command);
+        for(reg = first; reg <= last; reg++) block[reg - first] = Dirty(reg) ? staged[reg] : shadow[reg];
+        run_ack = LTC2946_write_block(first, block, last - first + 1);
+        ack |= run_ack;
+        commit_bytes += 2 + (last - first + 1);
 
-        Wire3.write(data.b[1]);
-        Wire3.write(data.b[0]);
-        ack = Wire3.endTransmission(false);
+        for(reg = first; reg <= last; reg++)
+        {
+            if(Dirty(reg)) single_bytes += 3;
+            if(run_ack == LTC2946_OK) dirty[reg / 8] &= ~(1 << (reg % 8));
+        }
     }
 
-  return(ack);
+    //update error
+    I2C_ACK |= ack;
+
+    return(single_bytes - commit_bytes);
 }
 
-// Write a 24-bit code to the LTC2946.
-int8_t LTC2946::LTC2946_write_24_bits(uint8_t adc_command, uint32_t code)
-// The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+bool LTC2946::Dirty(uint8_t adc_command)
 {
-    int8_t ack;
+    return((dirty[adc_command / 8] >> (adc_command % 8)) & 1);
+}
 
-    union
+int8_t LTC2946::ConfigRange(uint8_t adc_command)
+{
+    uint8_t r;
+
+    for(r = 0; r < LTC2946_CONFIG_RANGES; r++)
     {
-        int32_t MY_int32;    //!< 32-bit signed integer to be converted to four bytes
-        uint32_t MY_uint32;  //!< 32-bit unsigned integer to be converted to four bytes
-        uint8_t MY_byte[4];  //!< 4 bytes (unsigned 8-bit integers) to be converted to a 32-bit signed or unsigned integer
-    } data;
+        if(adc_command >= config_range[r][0] && adc_command < config_range[r][0] + config_range[r][1]) return(r);
+    }
+    return(-1);
+}
 
+bool LTC2946::VerifyConfig()
+{
+    uint8_t regs[LTC2946_REG_COUNT];
+    uint8_t r, i;
+    int8_t ack;
 
-    data.MY_int32 = code;
+    ack = LTC2946_read_block(LTC2946_CTRLA_REG, regs, LTC2946_REG_COUNT);
+    I2C_ACK |= ack;
+    if(ack != 0) return(false);
 
-    //  ack = i2c_write_block_data(i2c_address, adc_command, (uint8_t) 3, data.LT_byte);
+    //A snapshot trigger stands in for the configured CTRLA
+    if(ctrla_triggered)
+    {
+        if(regs[LTC2946_CTRLA_REG] != trigger_ctrla) return(false);
+        regs[LTC2946_CTRLA_REG] = shadow[LTC2946_CTRLA_REG];
+    }
 
-    if(I2C_WIRE == 0){
-        Wire.beginTransmission(I2C_ADDRESS);
-        Wire.write(adc_command);
+    for(r = 0; r < LTC2946_CONFIG_RANGES; r++)
+    {
+        for(i = config_range[r][0]; i < config_range[r][0] + config_range[r][1]; i++)
+        {
+            if(regs[i] != shadow[i]) return(false);
+        }
+    }
+    return(true);
+}
 
-        Wire.write(data.MY_byte[2]);
-        Wire.write(data.MY_byte[1]);
-        Wire.write(data.MY_byte[0]);
-        ack = Wire.endTransmission(false);
-    }else if(I2C_WIRE == 1){
-        Wire1.beginTransmission(I2C_ADDRESS);
-        Wire1.write(adc_command);
+void LTC2946::ResyncConfig()
+{
+    uint8_t regs[LTC2946_REG_COUNT];
+    uint8_t r;
+    int8_t ack;
 
-        Wire1.write(data.MY_byte[2]);
-        Wire1.write(data.MY_byte[1]);
-        Wire1.write(data.MY_byte[0]);
-        ack = Wire1.endTransmission(false);
-    }else if(I2C_WIRE == 2){
-        Wire2.beginTransmission(I2C_ADDRESS);
-        Wire2.write(adc_command);
+    ack = LTC2946_read_block(LTC2946_CTRLA_REG, regs, LTC2946_REG_COUNT);
+    I2C_ACK |= ack;
+    if(ack != 0) return;
 
-        Wire2.write(data.MY_byte[2]);
-        Wire2.write(data.MY_byte[1]);
-        Wire2.write(data.MY_byte[0]);
-        ack = Wire2.endTransmission(false);
-    }else if(I2C_WIRE == 3){
-        Wire3.beginTransmission(I2C_ADDRESS);
-        Wire3.write(adc_command);
+    for(r = 0; r < LTC2946_CONFIG_RANGES; r++)
+    {
+        LTC2946_shadow(config_range[r][0], &regs[config_range[r][0]], config_range[r][1]);
+    }
+}
+
+void LTC2946::RestoreConfig()
+{
+    uint8_t r, i;
 
-        Wire3.write(data.MY_byte[2]);
-        Wire3.write(data.MY_byte[1]);
-        Wire3.write(data.MY_byte[0]);
-        ack = Wire3.endTransmission(false);
+    for(r = 0; r < LTC2946_CONFIG_RANGES; r++)
+    {
+        for(i = config_range[r][0]; i < config_range[r][0] + config_range[r][1]; i++) StageConfig(i, shadow[i]);
     }
+    Commit();
+}
 
-    return(ack);
+void LTC2946::PowerOnImage(uint8_t *regs)
+{
+    memset(regs, 0, LTC2946_REG_COUNT);
+
+    regs[LTC2946_CTRLA_REG] = LTC2946_CHANNEL_CONFIG_V_C_3|LTC2946_SENSE_PLUS|LTC2946_OFFSET_CAL_EVERY|LTC2946_ADIN_GND;
+
+    //Min registers start at full scale, max thresholds at full scale so no alert fires
+    memset(&regs[LTC2946_MIN_POWER_MSB2_REG], 0xFF, 3);
+    memset(&regs[LTC2946_MAX_POWER_THRESHOLD_MSB2_REG], 0xFF, 3);
+    memset(&regs[LTC2946_MIN_DELTA_SENSE_MSB_REG], 0xFF, 2);
+    memset(&regs[LTC2946_MAX_DELTA_SENSE_THRESHOLD_MSB_REG], 0xFF, 2);
+    memset(&regs[LTC2946_MIN_VIN_MSB_REG], 0xFF, 2);
+    memset(&regs[LTC2946_MAX_VIN_THRESHOLD_MSB_REG], 0xFF, 2);
+    memset(&regs[LTC2946_MIN_ADIN_MSB_REG], 0xFF, 2);
+    memset(&regs[LTC2946_MAX_ADIN_THRESHOLD_MSB_REG], 0xFF, 2);
 }
 
-int8_t LTC2946::LTC2946_write_32_bits(uint8_t adc_command, uint32_t code)
-// The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+uint8_t LTC2946::CurrentConversions(uint8_t ctrla)
 {
-    int8_t ack;
+    uint8_t config = ctrla & ~LTC2946_CTRLA_CHANNEL_CONFIG_MASK;
 
-    union
-    {
-        int32_t MY_int32;    //!< 32-bit signed integer to be converted to four bytes
-        uint32_t MY_uint32;  //!< 32-bit unsigned integer to be converted to four bytes
-        uint8_t MY_byte[4];  //!< 4 bytes (unsigned 8-bit integers) to be converted to a 32-bit signed or unsigned integer
-    } data;
+    return((config == LTC2946_CHANNEL_CONFIG_SNAPSHOT) ? 0 : current_count[config]);
+}
 
+uint8_t LTC2946::Address()
+{
+    return(I2C_ADDRESS);
+}
 
-    data.MY_int32 = code;
+void LTC2946::MirrorConfig(uint8_t adc_command, const uint8_t *block, uint8_t len)
+{
+    uint8_t i;
 
-    if(I2C_WIRE == 0){
-        Wire.beginTransmission(I2C_ADDRESS);
-        Wire.write(adc_command);
+    LTC2946_shadow(adc_command, block, len);
 
-        Wire.write(data.MY_byte[3]);
-        Wire.write(data.MY_byte[2]);
-        Wire.write(data.MY_byte[1]);
-        Wire.write(data.MY_byte[0]);
-        ack = Wire.endTransmission(false);
-    }else if(I2C_WIRE == 1){
-        Wire1.beginTransmission(I2C_ADDRESS);
-        Wire1.write(adc_command);
+    //A broadcast snapshot trigger does not supersede a staged CTRLA
+    for(i = 0; i < len && adc_command + i < LTC2946_REG_COUNT; i++)
+    {
+        if(adc_command + i == LTC2946_CTRLA_REG && ctrla_triggered) continue;
+        dirty[(adc_command + i) / 8] &= ~(1 << ((adc_command + i) % 8));
+    }
+}
 
-        Wire1.write(data.MY_byte[3]);
-        Wire1.write(data.MY_byte[2]);
-        Wire1.write(data.MY_byte[1]);
-        Wire1.write(data.MY_byte[0]);
-        ack = Wire1.endTransmission(false);
-    }else if(I2C_WIRE == 2){
-        Wire2.beginTransmission(I2C_ADDRESS);
-        Wire2.write(adc_command);
+void LTC2946::LTC2946_shadow(uint8_t adc_command, const uint8_t *block, uint8_t len)
+{
+    uint8_t i, reg;
 
-        Wire2.write(data.MY_byte[3]);
-        Wire2.write(data.MY_byte[2]);
-        Wire2.write(data.MY_byte[1]);
-        Wire2.write(data.MY_byte[0]);
-        ack = Wire2.endTransmission(false);
-    }else if(I2C_WIRE == 3){
-        Wire3.beginTransmission(I2C_ADDRESS);
-        Wire3.write(adc_command);
+    for(i = 0; i < len && adc_command + i < LTC2946_REG_COUNT; i++)
+    {
+        reg = adc_command + i;
+        if(ConfigRange(reg) < 0) continue;
 
-        Wire3.write(data.MY_byte[3]);
-        Wire3.write(data.MY_byte[2]);
-        Wire3.write(data.MY_byte[1]);
-        Wire3.write(data.MY_byte[0]);
-        ack = Wire3.endTransmission(false);
+        if(reg == LTC2946_CTRLA_REG)
+        {
+            ctrla_triggered = (block[i] & ~LTC2946_CTRLA_CHANNEL_CONFIG_MASK) == LTC2946_CHANNEL_CONFIG_SNAPSHOT;
+            trigger_ctrla = block[i];
+            if(ctrla_triggered) continue;
+        }
+        shadow[reg] = block[i];
     }
+}
 
-    // ack = i2c_write_block_data(i2c_address, adc_command, (uint8_t) 4, data.LT_byte);
+bool LTC2946::StartRead(uint8_t adc_command, uint8_t bits)
+{
+    if(async_bits != 0 || Quarantined()) return(false);
+    if(bits == 0 || bits > 8 * sizeof(async_data)) return(false);
 
-    return(ack);
+    async_xfer.address = I2C_ADDRESS;
+    async_xfer.adc_command = adc_command;
+    async_xfer.data = async_data;
+    async_xfer.len = (bits + 7) / 8;
+
+    //The bus takes the read's deadline from the timeout
+    I2C_BUS->SetTimeout(timeout_us);
+    LTC2946_TRACE_MARK(async_trace_start);
+    if(!I2C_BUS->StartRead(&async_xfer)) return(false);
+
+    async_bits = bits;
+    return(true);
 }
 
-// Reads an 8-bit adc_code from LTC2946
-int8_t LTC2946::LTC2946_read(uint8_t adc_command, uint8_t *adc_code)
-// The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+bool LTC2946::IsDone()
 {
-    int8_t ack;
+    if(async_bits == 0) return(true);
 
-    //  ack = i2c_read_byte_data(i2c_address, adc_command, adc_code);
+    I2C_BUS->Poll();
+    if(!async_xfer.done) return(false);
 
-    if(I2C_WIRE == 0){
-        Wire.beginTransmission(I2C_ADDRESS);
-        Wire.write(adc_command);
+    //Finished: decode once and hand to the callback, if any
+    async_code = LTC2946_decode(async_data, async_bits);
+    async_bits = 0;
 
-        ack = Wire.endTransmission(false);
+    //update error
+    I2C_ACK |= LTC2946_record(async_xfer.adc_command, async_xfer.ack);
+    LTC2946_recover(async_xfer.ack);
+    LTC2946_quarantine(async_xfer.ack);
+    LTC2946_TRACE_END(async_trace_start, I2C_ADDRESS, async_xfer.adc_command, async_xfer.len, false, async_xfer.ack);
 
-        Wire.requestFrom(I2C_ADDRESS, (uint8_t)1);
+    if(async_callback != NULL) async_callback(this, async_xfer.adc_command, async_code);
+    return(true);
+}
 
-        *adc_code = Wire.read();
-    }else if(I2C_WIRE == 1){
-        Wire1.beginTransmission(I2C_ADDRESS);
-        Wire1.write(adc_command);
+uint32_t LTC2946::Collect()
+{
+    while(!IsDone());
+    return(async_code);
+}
 
-        ack = Wire1.endTransmission(false);
+void LTC2946::OnReadDone(LTC2946_ReadCallback callback)
+{
+    async_callback = callback;
+}
 
-        Wire1.requestFrom(I2C_ADDRESS, (uint8_t)1);
+bool LTC2946::StartReadBlock(uint8_t adc_command, uint8_t *block, uint8_t len, LTC2946_Transfer *xfer)
+{
+    if(Quarantined()) return(false);
 
-        *adc_code = Wire1.read();
-    }else if(I2C_WIRE == 2){
-        Wire2.beginTransmission(I2C_ADDRESS);
-        Wire2.write(adc_command);
+    xfer->address = I2C_ADDRESS;
+    xfer->adc_command = adc_command;
+    xfer->data = block;
+    xfer->len = len;
 
-        ack = Wire2.endTransmission(false);
+    I2C_BUS->SetTimeout(timeout_us);
+    LTC2946_TRACE_MARK(block_trace_start);
+    return(I2C_BUS->StartRead(xfer));
+}
 
-        Wire2.requestFrom(I2C_ADDRESS, (uint8_t)1);
+int8_t LTC2946::FinishBlock(const LTC2946_Transfer *xfer)
+{
+    int8_t ack = LTC2946_record(xfer->adc_command, xfer->ack);
 
-        *adc_code = Wire2.read();
-    }else if(I2C_WIRE == 3){
-        Wire3.beginTransmission(I2C_ADDRESS);
-        Wire3.write(adc_command);
+    LTC2946_recover(ack);
+    LTC2946_quarantine(ack);
+    LTC2946_TRACE_END(block_trace_start, I2C_ADDRESS, xfer->adc_command, xfer->len, false, xfer->ack);
 
-        ack = Wire3.endTransmission(false);
+    //update error
+    I2C_ACK |= ack;
+    return(ack);
+}
 
-        Wire3.requestFrom(I2C_ADDRESS, (uint8_t)1);
+void LTC2946::SetTimeout(uint32_t timeout_us)
+{
+    this->timeout_us = timeout_us;
+}
 
-        *adc_code = Wire3.read();
-    }
+void LTC2946::SetRetryPolicy(uint8_t retries, uint32_t backoff_us)
+{
+    this->retries = (retries < LTC2946_MAX_RETRIES) ? retries : LTC2946_MAX_RETRIES;
+    this->backoff_us = backoff_us;
+}
 
-    return ack;
+void LTC2946::SetQuarantine(uint8_t failures, uint32_t quarantine_us)
+{
+    quarantine_failures = failures;
+    this->quarantine_us = quarantine_us;
 }
 
-// Reads a 12-bit adc_code from LTC2946
-int8_t LTC2946::LTC2946_read_12_bits(uint8_t adc_command, uint16_t *adc_code)
-// The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+bool LTC2946::Quarantined()
 {
-    // Use union type defined in Linduino.h to combine two uint8_t's (8-bit unsigned integers) into one uint16_t (unsigned 16-bit integer)
-    // Then, shift by 4 bits and return in *adc_code
-    int8_t ack;
+    if(!quarantined) return(false);
 
-    union
+    //Quarantine over: let the next transaction through as a probe. One more failure re-quarantines.
+    if(I2C_BUS->Micros() - quarantine_start_us >= quarantine_us)
     {
-        uint8_t b[2];
-        uint16_t w;
-    } data;
+        quarantined = false;
+        consecutive_failures = quarantine_failures - 1;
+    }
+    return(quarantined);
+}
 
+void LTC2946::ClearQuarantine()
+{
+    quarantined = false;
+    consecutive_failures = 0;
+}
 
-    //  ack = i2c_read_word_data(i2c_address, adc_command, adc_code);
+void LTC2946::SaveErrorState(LTC2946_ErrorState *state)
+{
+    state->error_flags = I2C_ACK;
+    state->quarantined = quarantined;
+    state->quarantine_start_us = quarantine_start_us;
+    state->consecutive_failures = consecutive_failures;
+}
 
-    if(I2C_WIRE == 0){
-        Wire.beginTransmission(I2C_ADDRESS);
-        Wire.write(adc_command);
+void LTC2946::RestoreErrorState(const LTC2946_ErrorState *state)
+{
+    I2C_ACK = state->error_flags;
+    quarantined = state->quarantined;
+    quarantine_start_us = state->quarantine_start_us;
+    consecutive_failures = state->consecutive_failures;
+}
 
-        ack = Wire.endTransmission(false);
+uint32_t LTC2946::WorstCaseUs()
+// Upper bound of one blocking transaction: a background read in flight runs into the timeout and is reset, every
+// attempt times out in both phases and recovers the bus, and every backoff is taken. 0 if unbounded (no timeout).
+{
+    uint64_t attempt_us, worst_us;
 
-        Wire.requestFrom(I2C_ADDRESS, (uint8_t)2);
+    if(timeout_us == 0) return(0);
 
-        data.b[1] = Wire.read();
-        data.b[0] = Wire.read();
-    }else if(I2C_WIRE == 1){
-        Wire1.beginTransmission(I2C_ADDRESS);
-        Wire1.write(adc_command);
+    //64 bits hold every term: retries is clamped to LTC2946_MAX_RETRIES
+    attempt_us = 2 * (uint64_t)timeout_us + (bus_recovery ? LTC2946_RECOVER_MAX_US : 0);
+    worst_us = timeout_us + LTC2946_RECOVER_MAX_US + (retries + 1) * attempt_us + backoff_us * ((1ULL << retries) - 1);
+    return(worst_us < 0xFFFFFFFF ? (uint32_t)worst_us : 0xFFFFFFFF);
+}
 
-        ack = Wire1.endTransmission(false);
+void LTC2946::SetBusRecovery(bool state)
+{
+    bus_recovery = state;
+}
 
-        Wire1.requestFrom(I2C_ADDRESS, (uint8_t)2);
+void LTC2946::EnableStuckBusTimer(bool wake_alert)
+{
+    UpdateConfig(LTC2946_CTRLB_REG, LTC2946_DISABLE_STUCK_BUS_RECOVER, LTC2946_ENABLE_STUCK_BUS_RECOVER);
+    UpdateConfig(LTC2946_ALERT2_REG, LTC2946_DISABLE_STUCK_BUS_WAKE_ALERT, wake_alert ? LTC2946_ENABLE_STUCK_BUS_WAKE_ALERT : 0);
+}
 
-        data.b[1] = Wire1.read();
-        data.b[0] = Wire1.read();
-    }else if(I2C_WIRE == 2){
-        Wire2.beginTransmission(I2C_ADDRESS);
-        Wire2.write(adc_command);
+int8_t LTC2946::ClearFaults(uint8_t *fault1, uint8_t *fault2)
+{
+    int8_t ack = 0;
+    int8_t status;
 
-        ack = Wire2.endTransmission(false);
+    status = LTC2946_read(LTC2946_FAULT1_REG, fault1);
+    if(status != 0) *fault1 = 0;
+    ack |= status;
+    status = LTC2946_read(LTC2946_FAULT2_REG, fault2);
+    if(status != 0) *fault2 = 0;
+    ack |= status;
+    ack |= LTC2946_write(LTC2946_FAULT1_REG, 0);
+    ack |= LTC2946_write(LTC2946_FAULT2_REG, 0);
 
-        Wire2.requestFrom(I2C_ADDRESS, (uint8_t)2);
+    //update error
+    I2C_ACK |= ack;
+    return(ack);
+}
 
-        data.b[1] = Wire2.read();
-        data.b[0] = Wire2.read();
-    }else if(I2C_WIRE == 3){
-        Wire3.beginTransmission(I2C_ADDRESS);
-        Wire3.write(adc_command);
+int8_t LTC2946::LastStatus()
+{
+    return(last_status);
+}
 
-        ack = Wire3.endTransmission(false);
+void LTC2946::GetErrorStats(LTC2946_ErrorStats *stats)
+{
+    *stats = error_stats;
+}
 
-        Wire3.requestFrom(I2C_ADDRESS, (uint8_t)2);
+void LTC2946::ClearErrorStats()
+{
+    memset(&error_stats, 0, sizeof(error_stats));
+}
 
-        data.b[1] = Wire3.read();
-        data.b[0] = Wire3.read();
-    }
+void LTC2946::Poll()
+{
+    I2C_BUS->Poll();
+}
 
-    //Serial.print(data.b[1],BIN); Serial.print(" | "); Serial.print(data.b[0],BIN); Serial.print(" | "); Serial.print(data.w,BIN); Serial.print(" | ");
+uint32_t LTC2946::LTC2946_decode(const uint8_t *data, uint8_t bits)
+{
+    uint32_t code = 0;
+    uint8_t i;
 
-    *adc_code = data.w;
+    for(i = 0; i < (bits + 7) / 8; i++) code = (code << 8) | data[i];
 
-    *adc_code >>= 4;
-    return ack;
+    //12-bit ADC codes are left justified in their register pair
+    if(bits == 12) code >>= 4;
+    return(code);
 }
 
-// Reads a 16-bit adc_code from LTC2946
-int8_t LTC2946::LTC2946_read_16_bits(uint8_t adc_command, uint16_t *adc_code)
-// The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+float LTC2946::ConvertVIN(uint16_t VIN_code)
 {
-    int8_t ack;
+    if(use_conversion)
+    {
+        if(use_legacy)
+        {
+            //Legacy conversion
+            return(LTC2946_VIN_code_to_voltage(VIN_code));
+        }
+        //Experimental conversion
+        return((float)VIN_code*VIN_CONST);
+    }
+    //Return RAW value
+    return((float)VIN_code);
+}
 
-    union
+float LTC2946::ConvertCurrent(uint16_t current_code)
+{
+    if(use_conversion)
     {
-        uint8_t b[2];
-        uint16_t w;
-    } data;
+        if(use_legacy)
+        {
+            //Legacy conversion
+            return(LTC2946_code_to_current(current_code));
+        }
+        //Experimental conversion
+        return((float)current_code*CURRENT_CONST);
+    }
+    //Return RAW value
+    return((float)current_code);
+}
 
-    // ack = i2c_read_word_data(i2c_address, adc_command, adc_code);
+float LTC2946::ConvertPower(uint32_t power_code)
+{
+    if(use_conversion)
+    {
+        if(use_legacy)
+        {
+            //Legacy conversion
+            //Not available yet
+            return(0);
+        }
+        //Experimental conversion
+        return((float)power_code*POWER_CONST);
+    }
+    //Return RAW value
+    return((float)power_code);
+}
 
-    if(I2C_WIRE == 0){
-        Wire.beginTransmission(I2C_ADDRESS);
-        Wire.write(adc_command);
+// Decode the measurement block. Offsets are relative to LTC2946_MEAS_BLOCK_START.
+void LTC2946::DecodeAll(const uint8_t *block, LTC2946_Measurement *data)
+{
+    #define BLOCK_24(reg) (((uint32_t)block[(reg) - LTC2946_MEAS_BLOCK_START] << 16) | ((uint32_t)block[(reg) - LTC2946_MEAS_BLOCK_START + 1] << 8) | block[(reg) - LTC2946_MEAS_BLOCK_START + 2])
+    #define BLOCK_12(reg) ((uint16_t)(((uint16_t)block[(reg) - LTC2946_MEAS_BLOCK_START] << 8) | block[(reg) - LTC2946_MEAS_BLOCK_START + 1]) >> 4)
 
-        ack = Wire.endTransmission(false);
+    data->power_code = BLOCK_24(LTC2946_POWER_MSB2_REG);
+    data->max_power_code = BLOCK_24(LTC2946_MAX_POWER_MSB2_REG);
+    data->min_power_code = BLOCK_24(LTC2946_MIN_POWER_MSB2_REG);
+    data->max_power_threshold_code = BLOCK_24(LTC2946_MAX_POWER_THRESHOLD_MSB2_REG);
+    data->min_power_threshold_code = BLOCK_24(LTC2946_MIN_POWER_THRESHOLD_MSB2_REG);
 
-        Wire.requestFrom(I2C_ADDRESS, (uint8_t)2);
+    data->delta_sense_code = BLOCK_12(LTC2946_DELTA_SENSE_MSB_REG);
+    data->max_delta_sense_code = BLOCK_12(LTC2946_MAX_DELTA_SENSE_MSB_REG);
+    data->min_delta_sense_code = BLOCK_12(LTC2946_MIN_DELTA_SENSE_MSB_REG);
+    data->max_delta_sense_threshold_code = BLOCK_12(LTC2946_MAX_DELTA_SENSE_THRESHOLD_MSB_REG);
+    data->min_delta_sense_threshold_code = BLOCK_12(LTC2946_MIN_DELTA_SENSE_THRESHOLD_MSB_REG);
 
-        data.b[1] = Wire.read();
-        data.b[0] = Wire.read();
-    }else if(I2C_WIRE == 1){
-        Wire1.beginTransmission(I2C_ADDRESS);
-        Wire1.write(adc_command);
+    data->vin_code = BLOCK_12(LTC2946_VIN_MSB_REG);
 
-        ack = Wire1.endTransmission(false);
+    #undef BLOCK_24
+    #undef BLOCK_12
 
-        Wire1.requestFrom(I2C_ADDRESS, (uint8_t)2);
+    data->vin = ConvertVIN(data->vin_code);
+    data->current = ConvertCurrent(data->delta_sense_code);
+    data->power = ConvertPower(data->power_code);
+}
 
-        data.b[1] = Wire1.read();
-        data.b[0] = Wire1.read();
-    }else if(I2C_WIRE == 2){
-        Wire2.beginTransmission(I2C_ADDRESS);
-        Wire2.write(adc_command);
 
-        ack = Wire2.endTransmission(false);
 
-        Wire2.requestFrom(I2C_ADDRESS, (uint8_t)2);
 
-        data.b[1] = Wire2.read();
-        data.b[0] = Wire2.read();
-    }else if(I2C_WIRE == 3){
-        Wire3.beginTransmission(I2C_ADDRESS);
-        Wire3.write(adc_command);
+/*
+Here is where I would add provisions for limits and colombs and joules, if I ever find time for that
+*/
 
-        ack = Wire3.endTransmission(false);
 
-        Wire3.requestFrom(I2C_ADDRESS, (uint8_t)2);
 
-        data.b[1] = Wire3.read();
-        data.b[0] = Wire3.read();
-    }
 
-    *adc_code = data.w;
 
-    return ack;
+
+// Write an 8-bit code to the LTC2946.
+int8_t LTC2946::LTC2946_write(uint8_t adc_command, uint8_t code)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    return(LTC2946_write_block(adc_command, &code, 1));
 }
 
-// Reads a 24-bit adc_code from LTC2946
-int8_t LTC2946::LTC2946_read_24_bits(uint8_t adc_command, uint32_t *adc_code)
-// The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+// Write a 16-bit code to the LTC2946.
+int8_t LTC2946::LTC2946_write_16_bits(uint8_t adc_command, uint16_t code)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
 {
-    int8_t ack;
+    uint8_t data[2];
 
-    union
-    {
-        int32_t MY_int32;    //!< 32-bit signed integer to be converted to four bytes
-        uint32_t MY_uint32;  //!< 32-bit unsigned integer to be converted to four bytes
-        uint8_t MY_byte[4];  //!< 4 bytes (unsigned 8-bit integers) to be converted to a 32-bit signed or unsigned integer
-    } data;
+    data[0] = code >> 8;
+    data[1] = code;
 
-    // ack = i2c_read_block_data(i2c_address, adc_command, (uint8_t)3, data.LT_byte);
+    return(LTC2946_write_block(adc_command, data, 2));
+}
 
-    if(I2C_WIRE == 0){
-        Wire.beginTransmission(I2C_ADDRESS);
-        Wire.write(adc_command);
+// Write a 24-bit code to the LTC2946.
+int8_t LTC2946::LTC2946_write_24_bits(uint8_t adc_command, uint32_t code)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    uint8_t data[3];
 
-        ack = Wire.endTransmission(false);
+    data[0] = code >> 16;
+    data[1] = code >> 8;
+    data[2] = code;
 
-        Wire.requestFrom(I2C_ADDRESS, (uint8_t)3);
+    return(LTC2946_write_block(adc_command, data, 3));
+}
 
-        data.MY_byte[2] = Wire.read();
-        data.MY_byte[1] = Wire.read();
-        data.MY_byte[0] = Wire.read();
-    }else if(I2C_WIRE == 1){
-        Wire1.beginTransmission(I2C_ADDRESS);
-        Wire1.write(adc_command);
+// Write a 32-bit code to the LTC2946.
+int8_t LTC2946::LTC2946_write_32_bits(uint8_t adc_command, uint32_t code)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    uint8_t data[4];
 
-        ack = Wire1.endTransmission(false);
+    data[0] = code >> 24;
+    data[1] = code >> 16;
+    data[2] = code >> 8;
+    data[3] = code;
 
-        Wire1.requestFrom(I2C_ADDRESS, (uint8_t)3);
+    return(LTC2946_write_block(adc_command, data, 4));
+}
 
-        data.MY_byte[2] = Wire1.read();
-        data.MY_byte[1] = Wire1.read();
-        data.MY_byte[0] = Wire1.read();
-    }else if(I2C_WIRE == 2){
-        Wire2.beginTransmission(I2C_ADDRESS);
-        Wire2.write(adc_command);
+// Write len consecutive registers starting at adc_command in one auto-incrementing transaction
+int8_t LTC2946::LTC2946_write_block(uint8_t adc_command, const uint8_t *block, uint8_t len)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    int8_t ack;
 
-        ack = Wire2.endTransmission(false);
+    //The shadow follows what the device acknowledged
+    ack = LTC2946_transact(true, adc_command, (uint8_t *)block, len);
+    if(ack == LTC2946_OK) LTC2946_shadow(adc_command, block, len);
+    return(ack);
+}
 
-        Wire2.requestFrom(I2C_ADDRESS, (uint8_t)3);
+// Run one register transaction under the timeout, retry and quarantine policy
+int8_t LTC2946::LTC2946_transact(bool write, uint8_t adc_command, uint8_t *block, uint8_t len)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    uint32_t start, elapsed;
+    uint64_t backoff;
+    uint8_t attempt;
+    int8_t status;
 
-        data.MY_byte[2] = Wire2.read();
-        data.MY_byte[1] = Wire2.read();
-        data.MY_byte[0] = Wire2.read();
-    }else if(I2C_WIRE == 3){
-        Wire3.beginTransmission(I2C_ADDRESS);
-        Wire3.write(adc_command);
+    //Quarantined: fail fast without touching the bus
+    if(Quarantined())
+    {
+        last_status = LTC2946_ERR_QUARANTINED;
+        error_stats.skipped++;
+        return(LTC2946_ERR_QUARANTINED);
+    }
 
-        ack = Wire3.endTransmission(false);
+    LTC2946_TRACE_BEGIN(trace_start);
+    start = I2C_BUS->Micros();
+    I2C_BUS->SetTimeout(timeout_us);
+    for(attempt = 0; ; attempt++)
+    {
+        status = write ? I2C_BUS->Write(I2C_ADDRESS, adc_command, block, len) : I2C_BUS->Read(I2C_ADDRESS, adc_command, block, len);
+        if(status == LTC2946_OK) break;
 
-        Wire3.requestFrom(I2C_ADDRESS, (uint8_t)3);
+        LTC2946_recover(status);
+        if(attempt >= retries) break;
 
-        data.MY_byte[2] = Wire3.read();
-        data.MY_byte[1] = Wire3.read();
-        data.MY_byte[0] = Wire3.read();
+        error_stats.retries++;
+        backoff = (uint64_t)backoff_us << attempt;
+        I2C_BUS->Delay(backoff < 0xFFFFFFFF ? (uint32_t)backoff : 0xFFFFFFFF);
     }
+    elapsed = I2C_BUS->Micros() - start;
+    if(elapsed > error_stats.max_transaction_us) error_stats.max_transaction_us = elapsed;
 
-    *adc_code = 0x0FFFFFF & data.MY_int32;
-    return(ack);
+    LTC2946_quarantine(status);
+    LTC2946_TRACE_END(trace_start, I2C_ADDRESS, adc_command, len, write, status);
+    return(LTC2946_record(adc_command, status));
 }
 
-// Reads a 32-bit adc_code from LTC2946
-int8_t LTC2946::LTC2946_read_32_bits(uint8_t adc_command, uint32_t *adc_code)
-// The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+// Count consecutive failures and quarantine the device once it reaches the limit
+void LTC2946::LTC2946_quarantine(int8_t status)
 {
-    int8_t ack;
-
-    union
+    if(status == LTC2946_OK)
     {
-        int32_t MY_int32;    //!< 32-bit signed integer to be converted to four bytes
-        uint32_t MY_uint32;  //!< 32-bit unsigned integer to be converted to four bytes
-        uint8_t MY_byte[4];  //!< 4 bytes (unsigned 8-bit integers) to be converted to a 32-bit signed or unsigned integer
-    } data;
+        consecutive_failures = 0;
+        return;
+    }
+
+    if(quarantine_failures == 0 || ++consecutive_failures < quarantine_failures) return;
+
+    quarantined = true;
+    quarantine_start_us = I2C_BUS->Micros();
+    error_stats.quarantines++;
+}
+
+// After a failed transaction, clock the bus free if a device is holding SDA low, and time the recovery
+void LTC2946::LTC2946_recover(int8_t status)
+{
+    uint32_t start, elapsed;
 
-    // ack = i2c_read_block_data(i2c_address, adc_command, (uint8_t) 4, data.LT_byte);
+    if(status == LTC2946_OK || !bus_recovery || !I2C_BUS->BusStuck()) return;
 
-    if(I2C_WIRE == 0){
-        Wire.beginTransmission(I2C_ADDRESS);
-        Wire.write(adc_command);
+    start = I2C_BUS->Micros();
+    if(I2C_BUS->Recover()) error_stats.recoveries++;
+    else error_stats.recover_failures++;
+    elapsed = I2C_BUS->Micros() - start;
 
-        ack = Wire.endTransmission(false);
+    error_stats.last_recover_us = elapsed;
+    if(elapsed > error_stats.max_recover_us) error_stats.max_recover_us = elapsed;
+}
+
+// Book the status of one transaction in the per-device counters
+int8_t LTC2946::LTC2946_record(uint8_t adc_command, int8_t status)
+{
+    last_status = status;
+    error_stats.transactions++;
+    if(status == LTC2946_OK) return(status);
+
+    switch(status)
+    {
+        case LTC2946_ERR_ADDR_NACK: error_stats.addr_nacks++; break;
+        case LTC2946_ERR_DATA_NACK: error_stats.data_nacks++; break;
+        case LTC2946_ERR_TIMEOUT: error_stats.timeouts++; break;
+        case LTC2946_ERR_SHORT_READ: error_stats.short_reads++; break;
+        default: error_stats.other++; break;
+    }
+    error_stats.failures++;
+    error_stats.last_status = status;
+    error_stats.last_register = adc_command;
+    return(status);
+}
 
-        Wire.requestFrom(I2C_ADDRESS, (uint8_t)4);
+// Reads an 8-bit adc_code from LTC2946
+int8_t LTC2946::LTC2946_read(uint8_t adc_command, uint8_t *adc_code)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    return(LTC2946_read_block(adc_command, adc_code, 1));
+}
+
+// Reads a 12-bit adc_code from LTC2946
+int8_t LTC2946::LTC2946_read_12_bits(uint8_t adc_command, uint16_t *adc_code)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    // Combine MSB and LSB into one uint16_t, then shift by 4 bits and return in *adc_code
+    int8_t ack;
+    uint8_t data[2];
 
-        data.MY_byte[3] = Wire.read();
-        data.MY_byte[2] = Wire.read();
-        data.MY_byte[1] = Wire.read();
-        data.MY_byte[0] = Wire.read();
-    }else if(I2C_WIRE == 1){
-        Wire1.beginTransmission(I2C_ADDRESS);
-        Wire1.write(adc_command);
+    ack = LTC2946_read_block(adc_command, data, 2);
 
-        ack = Wire1.endTransmission(false);
+    *adc_code = ((uint16_t)data[0] << 8) | data[1];
 
-        Wire1.requestFrom(I2C_ADDRESS, (uint8_t)4);
+    *adc_code >>= 4;
+    return(ack);
+}
 
-        data.MY_byte[3] = Wire1.read();
-        data.MY_byte[2] = Wire1.read();
-        data.MY_byte[1] = Wire1.read();
-        data.MY_byte[0] = Wire1.read();
-    }else if(I2C_WIRE == 2){
-        Wire2.beginTransmission(I2C_ADDRESS);
-        Wire2.write(adc_command);
+// Reads a 16-bit adc_code from LTC2946
+int8_t LTC2946::LTC2946_read_16_bits(uint8_t adc_command, uint16_t *adc_code)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    int8_t ack;
+    uint8_t data[2];
 
-        ack = Wire2.endTransmission(false);
+    ack = LTC2946_read_block(adc_command, data, 2);
 
-        Wire2.requestFrom(I2C_ADDRESS, (uint8_t)4);
+    *adc_code = ((uint16_t)data[0] << 8) | data[1];
 
-        data.MY_byte[3] = Wire2.read();
-        data.MY_byte[2] = Wire2.read();
-        data.MY_byte[1] = Wire2.read();
-        data.MY_byte[0] = Wire2.read();
-    }else if(I2C_WIRE == 3){
-        Wire3.beginTransmission(I2C_ADDRESS);
-        Wire3.write(adc_command);
+    return(ack);
+}
 
-        ack = Wire3.endTransmission(false);
+// Reads a 24-bit adc_code from LTC2946
+int8_t LTC2946::LTC2946_read_24_bits(uint8_t adc_command, uint32_t *adc_code)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    int8_t ack;
+    uint8_t data[3];
 
-        Wire3.requestFrom(I2C_ADDRESS, (uint8_t)4);
+    ack = LTC2946_read_block(adc_command, data, 3);
 
-        data.MY_byte[3] = Wire3.read();
-        data.MY_byte[2] = Wire3.read();
-        data.MY_byte[1] = Wire3.read();
-        data.MY_byte[0] = Wire3.read();
-    }
+    *adc_code = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+    return(ack);
+}
 
+// Reads a 32-bit adc_code from LTC2946
+int8_t LTC2946::LTC2946_read_32_bits(uint8_t adc_command, uint32_t *adc_code)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    int8_t ack;
+    uint8_t data[4];
 
+    ack = LTC2946_read_block(adc_command, data, 4);
 
-    *adc_code = 0xFFFFFFFF & data.MY_int32;
+    *adc_code = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
     return(ack);
 }
 
+// Reads len consecutive registers from the LTC2946 in one auto-incrementing transaction
+int8_t LTC2946::LTC2946_read_block(uint8_t adc_command, uint8_t *block, uint8_t len)
+// The function returns the transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+{
+    return(LTC2946_transact(false, adc_command, block, len));
+}
+
 // Calculate the LTC2946 VIN voltage
 float LTC2946::LTC2946_VIN_code_to_voltage(uint16_t adc_code)
 // Returns the VIN Voltage in Volts
@@ -5,7 +5,7 @@ Revised Version
 Reformatted code into a single class, capable of functioning with Teensy 3.6.
 
 -Has full functionality for continuous read of VIN, Current and Power.
--Has limited functionality for Snapshot mode (VIN, Current) (to be done in future if time permits)
+-Has functionality for Snapshot mode (VIN, Current, and Power computed from back-to-back conversions)
 -Incorporated experimentally determined constants (one constant to correlate measured with actual value).
 -No limit functionality at this time.
 -I2C error transaction checking via a single function to check and clear past errors (use in an if statement)
@@ -75,7 +75,7 @@ Read power, current, voltage, charge and energy.
 #ifndef LTC2946_H
 #define LTC2946_H
 
-#include <Arduino.h>
+#include "LTC2946_Bus.h"
 
 //! Use table to select address
 /*!
@@ -115,6 +115,10 @@ Read power, current, voltage, charge and energy.
 #define LTC2946_I2C_MASS_WRITE      0xCC
 #define LTC2946_I2C_ALERT_RESPONSE  0x19
 
+// 7-bit forms of the shared addresses, as passed to i2c_t3 (the table above lists the 8-bit bus bytes)
+#define LTC2946_I2C_MASS_WRITE_7BIT     (LTC2946_I2C_MASS_WRITE >> 1)
+#define LTC2946_I2C_ALERT_RESPONSE_7BIT (LTC2946_I2C_ALERT_RESPONSE >> 1)
+
 
 /*!
 | Name                                              | Value |
@@ -511,6 +515,122 @@ Read power, current, voltage, charge and energy.
 #define LTC2946_GPIOCFG_GPIO2_OUT_MASK         0xFD
 #define LTC2946_GPIO3_CTRL_GPIO3_MASK          0xBF
 
+// Status bits
+#define LTC2946_STATUS2_ADC_BUSY               0x08
+#define LTC2946_FAULT2_ADC_DONE                0x80    //!< ADC conversion done, latched while ALERT2 enables its alert
+
+// Conversion timing, internal 250 kHz time base
+#define LTC2946_CURRENT_CONV_US                16404   //!< Delta sense conversion: 4101 clocks, one TIME_COUNTER tick
+#define LTC2946_VOLTAGE_CONV_US                2200    //!< VIN or ADIN conversion, approximate
+
+// Snapshot states (see LTC2946::TriggerSnapshot())
+#define LTC2946_SNAPSHOT_IDLE                  0       //!< Nothing requested, or the result was read
+#define LTC2946_SNAPSHOT_PENDING               1       //!< Conversion started
+#define LTC2946_SNAPSHOT_READY                 2       //!< Conversion finished, result waiting in its register
+#define LTC2946_SNAPSHOT_FAILED                3       //!< Trigger or status read failed on the bus
+#define LTC2946_SNAPSHOT_POLL_US               100     //!< Spacing of STATUS2 reads once a conversion is due
+#define LTC2946_SNAPSHOT_NO_PIN                0xFF    //!< No ADC-done alert pin: call SnapshotDone() from your own ISR
+#define LTC2946_SNAPSHOT_ALERT_PINS            4       //!< Devices with an ADC-done pin interrupt attached
+#define LTC2946_SEQUENCE_MAX_CHANNELS          3       //!< Delta sense, one of VDD/SENSE+, ADIN
+
+// Master-side stuck-bus recovery (LTC2946_Bus::Recover()): i2c_t3 resetBus() bit-bangs at most ten 10 us SCL clocks
+#define LTC2946_RECOVER_MAX_US                 150     //!< Bound of one recovery, clocks plus the peripheral reinitialization
+#define LTC2946_MAX_RETRIES                    16      //!< SetRetryPolicy() clamps retries to this
+
+//! Contiguous ranges of configuration registers (see LTC2946::config_range)
+#define LTC2946_CONFIG_RANGES                  6
+
+//! Largest run of clean registers Commit() rewrites to join two dirty ones into one transaction
+//! (a new transaction costs an address and a command byte)
+#define LTC2946_COMMIT_MAX_GAP                 2
+
+//! Register map span and the contiguous measurement block (POWER_MSB2 through VIN_LSB)
+#define LTC2946_REG_COUNT                      0x44
+#define LTC2946_MEAS_BLOCK_START               LTC2946_POWER_MSB2_REG
+#define LTC2946_MEAS_BLOCK_LEN                 (LTC2946_VIN_LSB_REG - LTC2946_POWER_MSB2_REG + 1)
+
+
+//! One coherent set of measurements decoded from a single burst read.
+//! Raw codes are always filled; vin/current/power follow the conversion settings of ReadVIN()/ReadCurrent()/ReadPower().
+struct LTC2946_Measurement {
+    float vin;
+    float current;
+    float power;
+
+    uint32_t power_code;
+    uint32_t max_power_code;
+    uint32_t min_power_code;
+    uint32_t max_power_threshold_code;
+    uint32_t min_power_threshold_code;
+
+    uint16_t delta_sense_code;
+    uint16_t max_delta_sense_code;
+    uint16_t min_delta_sense_code;
+    uint16_t max_delta_sense_threshold_code;
+    uint16_t min_delta_sense_threshold_code;
+
+    uint16_t vin_code;
+};
+
+
+//! Alert threshold codes, in the same units as the matching measurement codes
+struct LTC2946_Thresholds {
+    uint32_t max_power;         //!< 24-bit power code
+    uint32_t min_power;         //!< 24-bit power code
+    uint16_t max_delta_sense;   //!< 12-bit code
+    uint16_t min_delta_sense;   //!< 12-bit code
+    uint16_t max_vin;           //!< 12-bit code
+    uint16_t min_vin;           //!< 12-bit code
+    uint16_t max_adin;          //!< 12-bit code
+    uint16_t min_adin;          //!< 12-bit code
+};
+
+//! Per-device transaction outcome counters
+struct LTC2946_ErrorStats {
+    uint32_t transactions;      //!< Transactions issued
+    uint32_t failures;          //!< Transactions that did not return LTC2946_OK
+    uint32_t addr_nacks;        //!< NACK on the address byte
+    uint32_t data_nacks;        //!< NACK on a command or data byte
+    uint32_t timeouts;          //!< Transactions that timed out
+    uint32_t short_reads;       //!< Reads that returned fewer bytes than requested
+    uint32_t other;             //!< Any other bus error (arbitration lost, ...)
+    uint32_t retries;           //!< Extra attempts made by the retry policy
+    uint32_t quarantines;       //!< Times the device entered quarantine
+    uint32_t skipped;           //!< Transactions refused while quarantined
+    uint32_t max_transaction_us;//!< Longest blocking transaction, retries and backoff included
+    uint32_t recoveries;        //!< Stuck-bus recoveries that freed SDA
+    uint32_t recover_failures;  //!< Stuck-bus recoveries that left SDA low
+    uint32_t last_recover_us;   //!< Time-to-recover of the last stuck-bus recovery
+    uint32_t max_recover_us;    //!< Longest stuck-bus recovery
+    int8_t last_status;         //!< Status of the last failing transaction
+    uint8_t last_register;      //!< Register of the last failing transaction
+};
+
+//! Error flags behind ErrorCheck() and the quarantine state, saved around an operation whose failures are expected
+struct LTC2946_ErrorState {
+    uint8_t error_flags;        //!< Errors ErrorCheck() would report
+    bool quarantined;           //!< Quarantined at the time
+    uint32_t quarantine_start_us; //!< Start of that quarantine, so it ends when it would have
+    uint8_t consecutive_failures; //!< Failures counted towards the next quarantine
+};
+
+//! Snapshot counters. STATUS2 reads are the bus cost of waiting for conversions.
+struct LTC2946_SnapshotStats {
+    uint32_t snapshots;         //!< Snapshot results read
+    uint32_t status_reads;      //!< STATUS2 reads over every snapshot
+    uint16_t last_status_reads; //!< STATUS2 reads of the last snapshot
+    uint16_t max_status_reads;  //!< Most STATUS2 reads any snapshot needed
+    uint32_t last_conversion_us;//!< Trigger to observed completion of the last snapshot
+    uint32_t last_power_skew_us;//!< Time between the VIN and delta sense samples of the last snapshot power, midpoint to midpoint; 0 if either failed
+};
+
+class LTC2946;
+
+//! Called when a background read finishes
+typedef void (*LTC2946_ReadCallback)(LTC2946 *device,       //!< Device that issued the read
+                                     uint8_t adc_command,   //!< Register that was read
+                                     uint32_t code          //!< Decoded register code
+                                    );
 
 class LTC2946 {
 public:
@@ -518,11 +638,17 @@ public:
 	static const byte H = 1; //high
 	static const byte F = 2; //float
 
-    LTC2946(uint8_t wire_num, //! <Wire address. For Teensy 3.6, valid values are 0-2>
+#if defined(ARDUINO)
+    LTC2946(uint8_t wire_num, //! <Wire address. For Teensy 3.6, valid values are 0-3>
             uint8_t wire_addr //! <I2C address for LTC2946 on specified wire>
             );
+#endif
+    LTC2946(LTC2946_Bus &bus, //! <Bus object the LTC2946 sits on, shared with other devices on that bus>
+            uint8_t wire_addr //! <I2C address for LTC2946 on specified bus>
+            );
 
     void Setup(); //! <Initializes wire, call in Setup loop>
+    uint8_t Address(); //! <I2C address the instance was constructed with>
     bool ErrorCheck(); //! <Check the ack variable for errors. Returns True if no errors present. Resets ack variable on read>
 
     //! Set the constants for converting RAW to values
@@ -535,19 +661,239 @@ public:
     void EnableConversion(bool state); //! <Enable conversion to standard unit from RAW value>
     void EnableLegacy(bool state); //! <Enable use of legacy conversions, where available. If false, returns RAW value>
 
-    float ReadVIN(); //! <Read VIN from the LTC2946>
+    float ReadVIN(); //! <Read VIN from the LTC2946. In snapshot mode it converts the SetSnapshotVIN() channel, SENSE+ by default>
     float ReadCurrent(); //! <Read Current from the LTC2946>
     float ReadPower(); //! <Read Power from the LTC2946>
 
+    //! Channel converted for VIN in snapshot mode by ReadVIN(), ReadPower() and ReadSnapshotAll(). The default is
+    //! SENSE+, the voltage POWER uses in continuous mode at power-on. Snapshot ReadVIN() used to convert VDD;
+    //! SetSnapshotVIN(LTC2946_VDD) brings that reading back.
+    bool SetSnapshotVIN(uint8_t channel //!< LTC2946_SENSE_PLUS or LTC2946_VDD
+                       ); //! <Returns false and keeps the current channel for any other value>
+
+    //! Snapshot power. VIN (the SetSnapshotVIN() channel) and delta sense are converted
+    //! back to back and multiplied in software; snapshot ReadPower() does the same. The samples are not
+    //! simultaneous: delta sense starts once the VIN result is read, so their midpoints lie
+    //! (LTC2946_CURRENT_CONV_US + LTC2946_VOLTAGE_CONV_US) / 2 plus the bus time in between apart, about 10 ms
+    //! at 100 kHz. GetSnapshotStats() reports the measured skew. Fills vin, current, power and their codes only.
+    void ReadSnapshotAll(LTC2946_Measurement *data);
+
+    //! Non-blocking snapshot. TriggerSnapshot() starts one conversion (PENDING). PollSnapshot() touches the
+    //! bus only once the conversion is due, counted from the start of the CTRLA write, then reads STATUS2 at
+    //! most every LTC2946_SNAPSHOT_POLL_US until it is done (READY). ReadSnapshot() fetches the result (IDLE).
+    //! SnapshotDone() marks the conversion finished without any bus access, e.g. from an interrupt. In snapshot
+    //! mode ReadVIN()/ReadCurrent() run the same sequence and wait in between. Compared with reading STATUS2
+    //! back to back, this adds up to one STATUS2 read of latency and saves the rest of the reads: at 100 kHz,
+    //! VIN takes about 3.1 ms instead of 2.7 ms with one STATUS2 read instead of five (LTC2946_Bench).
+    bool TriggerSnapshot(uint8_t channel //!< LTC2946_DELTA_SENSE, LTC2946_VDD, LTC2946_ADIN or LTC2946_SENSE_PLUS
+                        ); //! <Write CTRLA to start the conversion. Returns false if the write failed>
+    uint8_t PollSnapshot(); //! <Advance the state machine. Returns LTC2946_SNAPSHOT_*>
+    void SnapshotDone(); //! <Mark the pending conversion finished. Safe to call from an interrupt>
+    uint8_t SnapshotState(); //! <Current LTC2946_SNAPSHOT_* state, no bus access>
+    uint16_t ReadSnapshot(); //! <Read the 12-bit code of a READY snapshot and return to IDLE. Errors are tracked for ErrorCheck()>
+    void GetSnapshotStats(LTC2946_SnapshotStats *stats); //! <Copy the snapshot counters>
+    void ClearSnapshotStats(); //! <Reset the snapshot counters>
+
+    //! ADC-done alert. EnableSnapshotAlert() sets the conversion done alert in ALERT2 and GPIO3 as the ALERT
+    //! output in one write, and on target attaches a falling-edge interrupt on alert_pin that calls SnapshotDone().
+    //! PollSnapshot() then reads no STATUS2 unless the edge is a full conversion time overdue. TriggerSnapshot()
+    //! clears FAULT2 right after starting the conversion, releasing ALERT for its edge. ALERT is wired-OR, so give
+    //! each device its own pin or keep one snapshot pending per line. Every conversion raises the alert: disable
+    //! it before SetContinuous().
+    bool EnableSnapshotAlert(uint8_t alert_pin = LTC2946_SNAPSHOT_NO_PIN //!< MCU pin wired to GPIO3 (ALERT)
+                            ); //! <Returns false if the configuration write failed or no interrupt slot is free, leaving the alert off>
+    void DisableSnapshotAlert(); //! <Back to STATUS2 polling; detaches the interrupt>
+
+    //! Sequenced snapshot of several channels. Each channel is triggered as soon as the previous result is
+    //! latched, and that result is read while the next channel converts, so only the last read adds to the
+    //! latency. At the end CTRLA gets back its configured value (ReadConfig()) in one write. VDD and SENSE+ share the VIN result register, so a sequence takes at most one of them.
+    bool StartSnapshotSequence(const uint8_t *channels, //!< LTC2946_DELTA_SENSE, LTC2946_VDD, LTC2946_ADIN or LTC2946_SENSE_PLUS
+                               uint8_t count            //!< 1 to LTC2946_SEQUENCE_MAX_CHANNELS
+                              ); //! <Returns false for an invalid sequence or if the first trigger failed>
+    uint8_t PollSnapshotSequence(); //! <Advance the sequence. Returns LTC2946_SNAPSHOT_*, READY once every code is in>
+    uint16_t SequenceCode(uint8_t index); //! <12-bit code of channels[index] from the last finished sequence>
+    bool ReadSnapshotSequence(const uint8_t *channels, uint8_t count, uint16_t *codes); //! <Blocking sequence into codes[count]. Returns false on failure>
+
+    //! Read POWER_MSB2 through VIN_LSB in one auto-incrementing transaction and decode every field.
+    //! If reg_map is given, the full 0x00-0x43 map (LTC2946_REG_COUNT bytes) is read into it instead and decoded from there.
+    void ReadAll(LTC2946_Measurement *data, //!< Decoded measurement block
+                 uint8_t *reg_map = NULL    //!< Optional LTC2946_REG_COUNT byte buffer for the full register map
+                );
+
+    //! Configuration shadow. The class mirrors CTRLA, CTRLB, ALERT1, ALERT2, GPIO_CFG, GPIO3_CTRL, CLK_DIV
+    //! and the threshold registers, so a field change is a single write with no read beforehand. A write lands
+    //! in the shadow only once the device acknowledged it. A CTRLA value selecting LTC2946_CHANNEL_CONFIG_SNAPSHOT
+    //! triggers a conversion and is not configuration: the shadow keeps the CTRLA from before, which
+    //! RestoreConfig() and the end of a snapshot sequence write back.
+    void WriteConfig(uint8_t adc_command, uint8_t code); //! <Write a configuration register>
+    void UpdateConfig(uint8_t adc_command, //!< Configuration register
+                      uint8_t mask,        //!< Bits to keep, e.g. LTC2946_CTRLA_CHANNEL_CONFIG_MASK
+                      uint8_t bits         //!< New field value, ORed in
+                     ); //! <Replace one field of a configuration register from the shadow>
+    uint8_t ReadConfig(uint8_t adc_command); //! <Shadowed value of a register, no bus access>
+    void SetThresholds(const LTC2946_Thresholds *thresholds); //! <Write every alert threshold>
+    bool VerifyConfig(); //! <Read the configuration back in one transaction. Returns true if it matches the shadow>
+    void ResyncConfig(); //! <Load the shadow from the device>
+    void RestoreConfig(); //! <Write the shadow back to the device, e.g. after a suspected reset>
+    static void PowerOnImage(uint8_t *regs); //! <Fill LTC2946_REG_COUNT bytes with the register map after power-on>
+    static uint8_t CurrentConversions(uint8_t ctrla); //! <Delta sense conversions per continuous-mode frame under a CTRLA value, 0 in snapshot mode>
+    //! Record registers another path wrote to this device, e.g. a mass-write broadcast (LTC2946_Fleet), in the
+    //! shadow without bus access. Staged values of those registers are dropped, the write superseded them.
+    void MirrorConfig(uint8_t adc_command,  //!< The "command byte" of the first register
+                      const uint8_t *block, //!< len bytes as written
+                      uint8_t len           //!< Number of registers written
+                     );
+
+    //! Write len consecutive registers in one auto-incrementing transaction
+    void WriteBlock(uint8_t adc_command,    //!< The "command byte" of the first register
+                    const uint8_t *block,   //!< len bytes to write
+                    uint8_t len             //!< Number of registers to write
+                   );
+
+    //! Staged configuration. Stage*() only record the values and mark registers dirty; Commit() writes every
+    //! dirty register in the fewest auto-increment transactions. Registers of a failed transaction stay dirty.
+    void StageConfig(uint8_t adc_command, uint8_t code); //! <Stage a register value>
+    void StageField(uint8_t adc_command, uint8_t mask, uint8_t bits); //! <Stage a field change, as UpdateConfig()>
+    void StageThresholds(const LTC2946_Thresholds *thresholds); //! <Stage every alert threshold>
+    uint16_t Commit(); //! <Write staged registers. Returns the bus bytes saved compared with one transaction per register>
+
+    //! Background (non-blocking) register reads. One read may be in flight per bus.
+    bool StartRead(uint8_t adc_command, //!< The "command byte" of the register
+                   uint8_t bits         //!< Register width: 8, 12, 16, 24 or 32
+                  ); //! <Returns false if bits is outside 1-32 or a background read is already in flight on the bus>
+    bool IsDone(); //! <Advances the bus. True once the background read has finished (or none is pending)>
+    uint32_t Collect(); //! <Waits for and returns the code of the background read, at most the timeout if one is set. Errors are tracked for ErrorCheck()>
+    void OnReadDone(LTC2946_ReadCallback callback); //! <Callback run from IsDone() when a background read finishes>
+
+    //! Background block read into a caller-supplied buffer (DMA backed when the bus runs in DMA mode).
+    //! xfer->done is raised once block holds len registers; xfer->ack holds the result.
+    bool StartReadBlock(uint8_t adc_command,    //!< The "command byte" of the first register
+                        uint8_t *block,         //!< Caller-supplied buffer of at least len bytes
+                        uint8_t len,            //!< Number of registers to read
+                        LTC2946_Transfer *xfer  //!< Caller-owned descriptor carrying the completion flag
+                       ); //! <Returns false if a background read is already in flight on the bus>
+    void Poll(); //! <Advance background transfers on this device's bus>
+    int8_t FinishBlock(const LTC2946_Transfer *xfer); //! <Book the result of a finished StartReadBlock() in the error counters, ErrorCheck() and LTC2946_Trace. Returns its status>
+
+    //! Bounded-latency policy. With a timeout set, no blocking transaction takes longer than WorstCaseUs().
+    void SetTimeout(uint32_t timeout_us); //! <Timeout per transaction attempt, 0 (default) for none>
+    void SetRetryPolicy(uint8_t retries,     //!< Extra attempts after a failure, 0 (default) for none, at most LTC2946_MAX_RETRIES
+                        uint32_t backoff_us  //!< Wait before the first retry, doubled for each further one
+                       );
+    void SetQuarantine(uint8_t failures,     //!< Consecutive failed transactions that quarantine the device, 0 (default) never
+                       uint32_t quarantine_us //!< Time transactions are refused with LTC2946_ERR_QUARANTINED
+                      );
+    bool Quarantined(); //! <True while the device is quarantined>
+    void ClearQuarantine(); //! <End a quarantine now and forget the consecutive failures counted towards one>
+    void SaveErrorState(LTC2946_ErrorState *state); //! <Save the ErrorCheck() flags and the quarantine state>
+    void RestoreErrorState(const LTC2946_ErrorState *state); //! <Put them back, dropping whatever happened since>
+    //! Upper bound of one blocking transaction, 0 if unbounded (no timeout): the wait for a background read in
+    //! flight and its reset, then per attempt the register pointer and data phases, each under the timeout, and
+    //! a stuck-bus recovery, plus every backoff. Background reads started by this device end after one timeout.
+    //! Saturates at 0xFFFFFFFF.
+    uint32_t WorstCaseUs();
+
+    //! Stuck-bus handling. After a failed transaction the master checks SDA and, if a device holds it low,
+    //! clocks it free (SetBusRecovery(false) turns this off). EnableStuckBusTimer() additionally arms the
+    //! device's own stuck-bus timer through CTRLB, and optionally its stuck-bus wake alert through ALERT2.
+    void SetBusRecovery(bool state); //! <Master-side recovery after a failed transaction, on by default>
+    void EnableStuckBusTimer(bool wake_alert //!< Also raise ALERT when the timer fires
+                            );
+
+    //! Read FAULT1 and FAULT2, then clear both, under this device's timeout and retry policy. A failed read
+    //! leaves its fault at 0. Used by LTC2946_Alert for devices it knows.
+    //! @return LTC2946_OK, otherwise the LTC2946_ERR_* status of the failing transactions ORed together.
+    int8_t ClearFaults(uint8_t *fault1, uint8_t *fault2);
+
+    //! Per-transaction status (LTC2946_OK or LTC2946_ERR_*) and error counters
+    int8_t LastStatus(); //! <Status of the most recent transaction>
+    void GetErrorStats(LTC2946_ErrorStats *stats); //! <Copy the error counters>
+    void ClearErrorStats(); //! <Reset the error counters>
+
+    //! Decode a measurement block read with StartReadBlock(LTC2946_MEAS_BLOCK_START, block, LTC2946_MEAS_BLOCK_LEN, ...)
+    void DecodeAll(const uint8_t *block,        //!< block[0] holds LTC2946_MEAS_BLOCK_START
+                   LTC2946_Measurement *data    //!< Decoded measurement block
+                  );
+
 
 private:
     byte I2C_ADDRESS; //stored I2C address of the LTC2946
-    uint8_t I2C_WIRE = 0; //stored wire number to use.
+    LTC2946_Bus *I2C_BUS; //stored bus the LTC2946 sits on.
     uint8_t I2C_ACK = 0; //variable that tracks acknowledgements for errors.
     uint8_t LTC2946_mode = 0; //variable that stores capture mode (0=continuous, 1=snapshot)
     bool use_conversion = false;
     bool use_legacy = false; //boolean T/F. Use legacy or experimental calculations (where available)
 
+    uint8_t shadow[LTC2946_REG_COUNT]; //last value the device acknowledged for each configuration register, power-on values until then
+    static const uint8_t config_range[LTC2946_CONFIG_RANGES][2];
+    static const uint8_t current_count[LTC2946_CHANNEL_CONFIG_SNAPSHOT];
+    uint8_t staged[LTC2946_REG_COUNT]; //values waiting for Commit()
+    uint8_t dirty[(LTC2946_REG_COUNT + 7) / 8] = {0}; //staged registers not yet written, one bit per register
+    bool ctrla_triggered = false; //CTRLA holds a snapshot trigger rather than the shadowed configuration
+    uint8_t trigger_ctrla = 0; //that trigger
+
+    bool Dirty(uint8_t adc_command);
+    int8_t ConfigRange(uint8_t adc_command); //! <Index into config_range holding the register, -1 if none>
+    //! Record registers the device now holds: configuration registers go into the shadow, a snapshot CTRLA
+    //! only marks the device as triggered, anything else is left out
+    void LTC2946_shadow(uint8_t adc_command, const uint8_t *block, uint8_t len);
+
+    //Transaction status tracking
+    int8_t last_status = LTC2946_OK;
+    LTC2946_ErrorStats error_stats = {};
+
+    //Timeout, retry and quarantine policy
+    uint32_t timeout_us = 0;
+    uint8_t retries = 0;
+    uint32_t backoff_us = 0;
+    uint8_t quarantine_failures = 0;
+    uint32_t quarantine_us = 0;
+    uint8_t consecutive_failures = 0;
+    bool quarantined = false;
+    uint32_t quarantine_start_us = 0;
+    bool bus_recovery = true;
+
+    //Snapshot state
+    volatile uint8_t snapshot_state = LTC2946_SNAPSHOT_IDLE;
+    uint8_t snapshot_channel = 0;
+    uint8_t snapshot_vin = LTC2946_SENSE_PLUS; //channel converted for VIN in snapshot mode
+    uint32_t snapshot_start_us = 0;
+    volatile uint32_t snapshot_ready_us = 0;
+    uint32_t snapshot_poll_us = 0; //earliest time of the next STATUS2 read
+    uint16_t snapshot_status_reads = 0; //STATUS2 reads of the pending snapshot
+    LTC2946_SnapshotStats snapshot_stats = {};
+    bool snapshot_alert = false; //completion is signalled by the ADC-done alert
+    uint8_t snapshot_pin = LTC2946_SNAPSHOT_NO_PIN;
+#if defined(ARDUINO)
+    static LTC2946 *snapshot_isr_owner[LTC2946_SNAPSHOT_ALERT_PINS];
+    static void SnapshotIsr0();
+    static void SnapshotIsr1();
+    static void SnapshotIsr2();
+    static void SnapshotIsr3();
+#endif
+    uint16_t LTC2946_snapshot(uint8_t channel); //! <Blocking snapshot of one channel. Returns its code, 0 on failure>
+    void LTC2946_snapshot_power(uint16_t *vin_code, uint16_t *current_code, uint32_t *power_code); //! <Back-to-back VIN and delta sense snapshots and their product>
+    void LTC2946_snapshot_finish(); //! <Book a finished snapshot in the counters and return to idle>
+    static uint8_t LTC2946_result_reg(uint8_t channel); //! <Result register (MSB) of a snapshot channel>
+
+    //Snapshot sequence state
+    uint8_t sequence_channels[LTC2946_SEQUENCE_MAX_CHANNELS];
+    uint16_t sequence_codes[LTC2946_SEQUENCE_MAX_CHANNELS];
+    uint8_t sequence_count = 0;
+    uint8_t sequence_next = 0; //index of the channel converting
+    uint8_t sequence_state = LTC2946_SNAPSHOT_IDLE;
+    bool sequence_failed = false; //a result read failed
+    void LTC2946_sequence_end(bool ok); //! <Restore CTRLA and settle the sequence as READY or FAILED>
+
+    //Background read state
+    LTC2946_Transfer async_xfer;
+    uint8_t async_data[4];
+    uint8_t async_bits = 0; //width of the pending background read, 0 when none is pending
+    uint32_t async_code = 0; //code of the last finished background read
+    LTC2946_ReadCallback async_callback = NULL;
+    uint32_t async_trace_start = 0; //LTC2946_Trace ticks when the background read started
+    uint32_t block_trace_start = 0; //LTC2946_Trace ticks when the last StartReadBlock() started
+
     //Constants for converting RAW to values. Experimentally calibrated for R = 0.02 ohm
     float VIN_CONST = 0.02485474;
     float CURRENT_CONST = 0.00119677419;
@@ -570,54 +916,86 @@ private:
     const uint8_t GPIO3_CTRL = LTC2946_GPIO3_OUT_HIGH_Z;                                                                //! Set GPIO3_CTRL to Default Value
     const uint8_t VOLTAGE_SEL = LTC2946_SENSE_PLUS;                                                                     //! Set Voltage selection to default value.
 
+    //! Convert RAW codes according to use_conversion/use_legacy
+    float ConvertVIN(uint16_t VIN_code);
+    float ConvertCurrent(uint16_t current_code);
+    float ConvertPower(uint32_t power_code);
+
+    //! Combine MSB-first register bytes into a code of the given width (8, 12, 16, 24 or 32)
+    static uint32_t LTC2946_decode(const uint8_t *data, uint8_t bits);
+
     //! Write an 8-bit code to the LTC2946.
-    //! @return The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
     int8_t LTC2946_write(uint8_t adc_command, //!< The "command byte" for the LTC2946
                      uint8_t code         //!< Value that will be written to the register.
                     );
     //! Write a 16-bit code to the LTC2946.
-    //! @return The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
     int8_t LTC2946_write_16_bits(uint8_t adc_command, //!< The "command byte" for the LTC2946
                              uint16_t code        //!< Value that will be written to the register.
                             );
 
     //! Write a 24-bit code to the LTC2946.
-    //! @return The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
     int8_t LTC2946_write_24_bits(uint8_t adc_command, //!< The "command byte" for the LTC2946
                              uint32_t code         //!< Value that will be written to the register.
                             );
     //! Write a 32-bit code to the LTC2946.
-    //! @return The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
     int8_t LTC2946_write_32_bits(uint8_t adc_command, //!< The "command byte" for the LTC2946
                              uint32_t code         //!< Value that will be written to the register.
                             );
 
+    //! Run one register transaction under the timeout, retry and quarantine policy
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+    int8_t LTC2946_transact(bool write, uint8_t adc_command, uint8_t *block, uint8_t len);
+    void LTC2946_quarantine(int8_t status); //! <Count consecutive failures and quarantine the device at the limit>
+    void LTC2946_recover(int8_t status); //! <After a failed transaction, clock the bus free if SDA is held low>
+
+    //! Book the status of one transaction in the per-device counters
+    //! @return status, unchanged
+    int8_t LTC2946_record(uint8_t adc_command, int8_t status);
+
+    //! Write len consecutive registers starting at adc_command in one auto-incrementing transaction, updating the shadow once acknowledged.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+    int8_t LTC2946_write_block(uint8_t adc_command,  //!< The "command byte" of the first register
+                               const uint8_t *block, //!< len bytes to write
+                               uint8_t len           //!< Number of registers to write
+                              );
+
     //! Reads an 8-bit adc_code from LTC2946
-    //! @return The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
     int8_t LTC2946_read(uint8_t adc_command, //!< The "command byte" for the LTC2946
                     uint8_t *adc_code    //!< Value that will be read from the register.
                    );
     //! Reads a 12-bit adc_code from LTC2946
-    //! @return The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
     int8_t LTC2946_read_12_bits(uint8_t adc_command, //!< The "command byte" for the LTC2946
                             uint16_t *adc_code   //!< Value that will be read from the register.
                            );
     //! Reads a 16-bit adc_code from LTC2946
-    //! @return The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
     int8_t LTC2946_read_16_bits(uint8_t adc_command, //!< The "command byte" for the LTC2946
                             uint16_t *adc_code   //!< Value that will be read from the register.
                            );
     //! Reads a 24-bit adc_code from LTC2946
-    //! @return The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
     int8_t LTC2946_read_24_bits(uint8_t adc_command, //!< The "command byte" for the LTC2946
                             uint32_t *adc_code    //!< Value that will be read from the register.
                            );
     //! Reads a 32-bit adc_code from LTC2946
-    //! @return The function returns the state of the acknowledge bit after the I2C address write. 0=acknowledge, 1=no acknowledge.
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
     int8_t LTC2946_read_32_bits(uint8_t adc_command, //!< The "command byte" for the LTC2946
                             uint32_t *adc_code    //!< Value that will be read from the register.
                            );
 
+    //! Reads len consecutive registers starting at adc_command in one auto-incrementing transaction
+    //! @return The transaction status, LTC2946_OK (0) or one of LTC2946_ERR_*.
+    int8_t LTC2946_read_block(uint8_t adc_command, //!< The "command byte" of the first register
+                          uint8_t *block,      //!< Buffer of at least len bytes
+                          uint8_t len          //!< Number of registers to read
+                         );
+
     //! Calculate the LTC2946 VIN voltage
     //! @return Returns the VIN Voltage in Volts
     float LTC2946_VIN_code_to_voltage(uint16_t adc_code          //!< The ADC value
@@ -0,0 +1,68 @@
+/*!
+LTC2946_Acquisition: concurrent acquisition across independent I2C buses.
+*/
+
+#include <stdint.h>
+#include "LTC2946_Acquisition.h"
+
+int8_t LTC2946_Acquisition::AddBus(LTC2946_BusManager &manager)
+{
+    if(bus_count >= LTC2946_MAX_BUSES) return(-1);
+
+    managers[bus_count] = &manager;
+    return(bus_count++);
+}
+
+uint8_t LTC2946_Acquisition::BusCount()
+{
+    return(bus_count);
+}
+
+LTC2946_BusManager &LTC2946_Acquisition::Manager(uint8_t bus)
+{
+    return(*managers[bus]);
+}
+
+void LTC2946_Acquisition::Service()
+{
+    uint8_t i;
+
+    if(bus_count == 0) return;
+
+    if(!started)
+    {
+        started = true;
+        start_us = managers[0]->Bus().Micros();
+    }
+
+    //Each manager only touches its own bus, so a transfer stays in flight on every bus between calls
+    for(i = 0; i < bus_count; i++) managers[i]->Service();
+}
+
+uint32_t LTC2946_Acquisition::Samples()
+{
+    uint32_t samples = 0;
+    uint8_t i;
+
+    for(i = 0; i < bus_count; i++) samples += managers[i]->Samples();
+    return(samples);
+}
+
+float LTC2946_Acquisition::Rate()
+{
+    uint32_t elapsed;
+
+    if(!started) return(0);
+
+    elapsed = managers[0]->Bus().Micros() - start_us;
+    if(elapsed == 0) return(0);
+    return((float)Samples() * 1000000.0 / (float)elapsed);
+}
+
+void LTC2946_Acquisition::ResetStats()
+{
+    uint8_t i;
+
+    for(i = 0; i < bus_count; i++) managers[i]->ResetStats();
+    started = false;
+}
@@ -0,0 +1,40 @@
+/*!
+LTC2946_Acquisition: concurrent acquisition across independent I2C buses.
+
+The Teensy 3.6 I2C peripherals (Wire through Wire3) run independently. The
+engine holds one LTC2946_BusManager per bus and services them round robin;
+each manager keeps a background burst read in flight on its own bus, so up
+to four transfers are on the wire at once and the total sample rate grows
+with the number of buses in use.
+*/
+
+#ifndef LTC2946_ACQUISITION_H
+#define LTC2946_ACQUISITION_H
+
+#include "LTC2946_BusManager.h"
+
+#define LTC2946_MAX_BUSES   4   //!< Wire, Wire1, Wire2, Wire3
+
+class LTC2946_Acquisition {
+public:
+    //! Add the manager of one bus.
+    //! @return The bus index, or -1 if LTC2946_MAX_BUSES are already added.
+    int8_t AddBus(LTC2946_BusManager &manager);
+    uint8_t BusCount(); //! <Number of buses in use>
+    LTC2946_BusManager &Manager(uint8_t bus); //! <Manager of a bus, by index returned from AddBus()>
+
+    void Service(); //! <Advance every bus, call from loop() as often as possible>
+
+    uint32_t Samples(); //! <Completed samples over every bus>
+    float Rate(); //! <Aggregate samples per second since the first Service() or ResetStats()>
+    void ResetStats(); //! <Clear statistics of every bus>
+
+private:
+    LTC2946_BusManager *managers[LTC2946_MAX_BUSES];
+    uint8_t bus_count = 0;
+
+    bool started = false;
+    uint32_t start_us = 0;  //time of the first Service(), on the first bus's time base
+};
+
+#endif  // LTC2946_ACQUISITION_H
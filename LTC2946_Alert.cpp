@@ -0,0 +1,109 @@
+/*!
+LTC2946_Alert: interrupt-driven servicing of the shared ALERT line.
+*/
+
+#include <stdint.h>
+#include "LTC2946_Alert.h"
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+
+LTC2946_Alert *LTC2946_Alert::isr_owner[LTC2946_ALERT_MAX_PINS] = {NULL, NULL, NULL, NULL};
+
+void LTC2946_Alert::Isr0() {isr_owner[0]->Signal();}
+void LTC2946_Alert::Isr1() {isr_owner[1]->Signal();}
+void LTC2946_Alert::Isr2() {isr_owner[2]->Signal();}
+void LTC2946_Alert::Isr3() {isr_owner[3]->Signal();}
+#endif
+
+LTC2946_Alert::LTC2946_Alert(LTC2946_Bus &bus, uint8_t alert_pin) : bus(bus), alert_pin(alert_pin) //!constructor
+{
+}
+
+bool LTC2946_Alert::Add(LTC2946 &device)
+{
+    if(device_count >= LTC2946_ALERT_MAX_DEVICES) return(false);
+
+    devices[device_count++] = &device;
+    return(true);
+}
+
+bool LTC2946_Alert::Begin()
+{
+#if defined(ARDUINO)
+    static void (* const isr[LTC2946_ALERT_MAX_PINS])(void) = {Isr0, Isr1, Isr2, Isr3};
+    uint8_t i;
+
+    if(alert_pin == LTC2946_ALERT_NO_PIN) return(false);
+
+    for(i = 0; i < LTC2946_ALERT_MAX_PINS; i++)
+    {
+        if(isr_owner[i] != NULL && isr_owner[i] != this) continue;
+
+        isr_owner[i] = this;
+        pinMode(alert_pin, INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(alert_pin), isr[i], FALLING);
+
+        //ALERT may already be low from before the interrupt was attached
+        if(digitalRead(alert_pin) == LOW) Signal();
+        return(true);
+    }
+#endif
+    return(false);
+}
+
+void LTC2946_Alert::OnAlert(LTC2946_AlertHandler handler)
+{
+    this->handler = handler;
+}
+
+void LTC2946_Alert::Signal()
+{
+    pending = true;
+}
+
+uint8_t LTC2946_Alert::Service()
+{
+    uint8_t response, address, fault1, fault2;
+    uint8_t cleared = 0;
+    uint8_t count, i;
+    int8_t ack = LTC2946_OK;
+
+    if(!pending) return(0);
+    pending = false;
+
+    //Each ARA read releases ALERT of one device; repeat until nobody answers
+    for(count = 0; count < LTC2946_ALERT_MAX_DEVICES; count++)
+    {
+        ack = bus.Receive(LTC2946_I2C_ALERT_RESPONSE_7BIT, &response, 1);
+        if(ack != LTC2946_OK) break;
+        address = response >> 1;
+
+        for(i = 0; i < device_count && devices[i]->Address() != address; i++);
+        if(i < device_count)
+        {
+            devices[i]->ClearFaults(&fault1, &fault2);
+        }
+        else
+        {
+            if(bus.Read(address, LTC2946_FAULT1_REG, &fault1, 1) != 0) fault1 = 0;
+            if(bus.Read(address, LTC2946_FAULT2_REG, &fault2, 1) != 0) fault2 = 0;
+            bus.Write(address, LTC2946_FAULT1_REG, &cleared, 1);
+            bus.Write(address, LTC2946_FAULT2_REG, &cleared, 1);
+        }
+
+        if(handler != NULL) handler(address, fault1, fault2);
+    }
+
+    //Only a NACKed ARA proves ALERT is released. Otherwise a device may still hold it low and no new
+    //edge will come, so stay pending for the next call.
+    if(ack != LTC2946_ERR_ADDR_NACK) pending = true;
+
+    serviced += count;
+    return(count);
+}
+
+uint32_t LTC2946_Alert::Serviced()
+{
+    return(serviced);
+}
@@ -0,0 +1,72 @@
+/*!
+LTC2946_Alert: interrupt-driven servicing of the shared ALERT line.
+
+The ALERT pins of the LTC2946 on a bus are wired-OR onto one MCU pin. A
+falling edge runs a small ISR that only marks the bus as pending; I2C
+traffic is left to Service() in loop(), since i2c_t3 transfers are
+themselves interrupt driven and cannot complete from inside a pin ISR.
+
+Service() reads the Alert Response Address (LTC2946_I2C_ALERT_RESPONSE) to
+find the asserting device, reads and clears its FAULT1/FAULT2 registers and
+passes them to the user handler, repeating until no device answers the ARA.
+Routine polling can then run slowly without missing fault events. If a
+call stops at LTC2946_ALERT_MAX_DEVICES or on a bus error before the ARA
+is NACKed, the alert stays pending and the next Service() carries on.
+
+For a device whose LTC2946 instance is Add()ed, the faults are read and
+cleared through the instance (LTC2946::ClearFaults()), so the accesses run
+under its timeout and retry policy, land in its error counters and keep its
+register image current. Other addresses are handled on the bus directly.
+*/
+
+#ifndef LTC2946_ALERT_H
+#define LTC2946_ALERT_H
+
+#include "LTC2946.h"
+
+#define LTC2946_ALERT_NO_PIN        0xFF    //!< No ALERT pin: Service() runs whenever Signal() was called
+#define LTC2946_ALERT_MAX_PINS      4       //!< ALERT lines with an ISR attached, one per bus
+#define LTC2946_ALERT_MAX_DEVICES   9       //!< ARA responses handled per Service() call
+
+//! Called from Service() for every device found through the Alert Response Address
+typedef void (*LTC2946_AlertHandler)(uint8_t address,   //!< 7-bit I2C address of the asserting device
+                                     uint8_t fault1,    //!< FAULT1 before it was cleared
+                                     uint8_t fault2     //!< FAULT2 before it was cleared
+                                    );
+
+class LTC2946_Alert {
+public:
+    LTC2946_Alert(LTC2946_Bus &bus,                         //! <Bus whose devices share the ALERT line>
+                  uint8_t alert_pin = LTC2946_ALERT_NO_PIN  //! <MCU pin wired to ALERT>
+                 );
+
+    //! Handle alerts of this device through its instance.
+    //! @return false if LTC2946_ALERT_MAX_DEVICES are already added.
+    bool Add(LTC2946 &device);
+
+    bool Begin(); //! <Attach the ALERT pin interrupt. Returns false if there is no pin or no free ISR slot>
+    void OnAlert(LTC2946_AlertHandler handler); //! <Handler run from Service() per asserting device>
+
+    void Signal(); //! <Mark an alert as pending. Called by the pin ISR, safe to call from any ISR>
+    uint8_t Service(); //! <Handle pending alerts, call from loop(). Returns the number of devices serviced>
+    uint32_t Serviced(); //! <Devices serviced since Begin()>
+
+private:
+    LTC2946_Bus &bus;
+    uint8_t alert_pin;
+    LTC2946_AlertHandler handler = NULL;
+    volatile bool pending = false;
+    uint32_t serviced = 0;
+    LTC2946 *devices[LTC2946_ALERT_MAX_DEVICES];
+    uint8_t device_count = 0;
+
+#if defined(ARDUINO)
+    static LTC2946_Alert *isr_owner[LTC2946_ALERT_MAX_PINS];
+    static void Isr0();
+    static void Isr1();
+    static void Isr2();
+    static void Isr3();
+#endif
+};
+
+#endif  // LTC2946_ALERT_H
@@ -0,0 +1,178 @@
+/*!
+LTC2946_Aligned: continuous-mode reads aligned to the conversion sequence.
+*/
+
+#include <stdint.h>
+#include "LTC2946_Aligned.h"
+
+LTC2946_Aligned::LTC2946_Aligned(LTC2946 &device, LTC2946_Bus &bus) : device(device), bus(bus) //!constructor
+{
+}
+
+bool LTC2946_Aligned::Begin(uint8_t ctrla, uint8_t channel)
+{
+    this->ctrla = ctrla;
+    this->channel = channel;
+
+    device.WriteConfig(LTC2946_CTRLA_REG, ctrla);
+
+    //The sequence did not restart: nothing to follow until the next Begin()
+    if(device.LastStatus() != LTC2946_OK)
+    {
+        never = true;
+        return(false);
+    }
+
+    //The sequence restarts when the write ends
+    frame_start_us = bus.Micros();
+    first_frame = true;
+    completed_before = 0;
+    last_completed = 0;
+    never = false;
+    Schedule(frame_start_us);
+    return(true);
+}
+
+bool LTC2946_Aligned::Service(LTC2946_Measurement *data)
+{
+    uint32_t now;
+
+    if(UntilDueUs() != 0) return(false);
+
+    now = bus.Micros();
+    device.ReadAll(data);
+    Book(now);
+    return(device.LastStatus() == LTC2946_OK);
+}
+
+uint32_t LTC2946_Aligned::UntilDueUs()
+{
+    int32_t left;
+
+    if(never) return(0xFFFFFFFF);
+
+    left = (int32_t)(due_us - bus.Micros());
+    return(left > 0 ? left : 0);
+}
+
+void LTC2946_Aligned::Account()
+{
+    Book(bus.Micros());
+}
+
+void LTC2946_Aligned::GetStats(LTC2946_AlignStats *stats)
+{
+    *stats = this->stats;
+}
+
+void LTC2946_Aligned::ResetStats()
+{
+    stats = {};
+}
+
+uint32_t LTC2946_Aligned::PeriodUs(uint8_t ctrla, uint8_t channel)
+{
+    uint16_t count;
+    uint32_t first_us, spacing_us, frame_us;
+
+    Layout(ctrla, false, channel, &count, &first_us, &spacing_us, &frame_us);
+    if(count == 0) return(0);
+    return(frame_us / count);
+}
+
+// The registers are sampled at the start of the read, so now is taken before it
+void LTC2946_Aligned::Book(uint32_t now)
+{
+    uint32_t completed = Completed(now);
+    uint32_t fresh = completed - last_completed;
+
+    stats.reads++;
+    if(fresh == 0) stats.duplicates++;
+    else stats.missed += fresh - 1;
+    stats.conversions = completed;
+    last_completed = completed;
+
+    Schedule(now);
+}
+
+uint32_t LTC2946_Aligned::Completed(uint32_t now)
+{
+    uint16_t count;
+    uint32_t first_us, spacing_us, frame_us, offset;
+
+    //Step the model over whole frames; elapsed time per frame stays small, so the counters survive Micros() wrapping
+    for(;;)
+    {
+        Layout(ctrla, first_frame, channel, &count, &first_us, &spacing_us, &frame_us);
+        offset = now - frame_start_us;
+        if(frame_us == 0 || offset < frame_us) break;
+
+        completed_before += count;
+        frame_start_us += frame_us;
+        first_frame = false;
+    }
+
+    if(frame_us == 0 || count == 0 || offset < first_us) return(completed_before);
+    if(spacing_us == 0) return(completed_before + 1);
+    offset = (offset - first_us) / spacing_us + 1;
+    return(completed_before + (offset < count ? offset : count));
+}
+
+void LTC2946_Aligned::Schedule(uint32_t now)
+{
+    uint16_t count;
+    uint32_t first_us, spacing_us, frame_us, done;
+
+    done = Completed(now) - completed_before;
+    Layout(ctrla, first_frame, channel, &count, &first_us, &spacing_us, &frame_us);
+    if(done < count)
+    {
+        due_us = frame_start_us + first_us + done * spacing_us + LTC2946_ALIGN_GUARD_US;
+        return;
+    }
+
+    //Next frame; its layout no longer changes after the first
+    due_us = frame_start_us + frame_us;
+    Layout(ctrla, false, channel, &count, &first_us, &spacing_us, &frame_us);
+    if(count == 0)
+    {
+        never = true;
+        return;
+    }
+    due_us += first_us + LTC2946_ALIGN_GUARD_US;
+}
+
+// A frame is VIN (unless V_C after its first frame), ADIN in the A_V_C modes, then the delta sense run
+void LTC2946_Aligned::Layout(uint8_t ctrla, bool first, uint8_t channel, uint16_t *count, uint32_t *first_us, uint32_t *spacing_us, uint32_t *frame_us)
+{
+    uint8_t config = ctrla & ~LTC2946_CTRLA_CHANNEL_CONFIG_MASK;
+    uint8_t vin, adin;
+
+    *count = 0;
+    *first_us = 0;
+    *spacing_us = 0;
+    *frame_us = 0;
+    if(config == LTC2946_CHANNEL_CONFIG_SNAPSHOT) return;
+
+    vin = (config != LTC2946_CHANNEL_CONFIG_V_C || first) ? 1 : 0;
+    adin = (config >= LTC2946_CHANNEL_CONFIG_A_V_C_3 && config <= LTC2946_CHANNEL_CONFIG_A_V_C_1) ? 1 : 0;
+    *frame_us = (vin + adin) * LTC2946_VOLTAGE_CONV_US + LTC2946::CurrentConversions(ctrla) * (uint32_t)LTC2946_CURRENT_CONV_US;
+
+    switch(channel)
+    {
+        case LTC2946_DELTA_SENSE:
+            *count = LTC2946::CurrentConversions(ctrla);
+            *first_us = (vin + adin) * LTC2946_VOLTAGE_CONV_US + LTC2946_CURRENT_CONV_US;
+            *spacing_us = LTC2946_CURRENT_CONV_US;
+            break;
+        case LTC2946_VDD:
+        case LTC2946_SENSE_PLUS:
+            *count = vin;
+            *first_us = LTC2946_VOLTAGE_CONV_US;
+            break;
+        case LTC2946_ADIN:
+            *count = adin;
+            *first_us = (vin + 1) * LTC2946_VOLTAGE_CONV_US;
+            break;
+    }
+}
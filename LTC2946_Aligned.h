@@ -0,0 +1,87 @@
+/*!
+LTC2946_Aligned: continuous-mode reads aligned to the conversion sequence.
+
+In continuous mode the ADC runs frames set by CTRLA[2:0]: VIN (SENSE+,
+VDD or ADIN, per CTRLA[4:3]) once, ADIN once in the A_V_C modes, then a
+run of delta sense conversions (1, 15 or 127 for V_C_3/2/1 and A_V_C_3,
+30 or 254 for A_V_C_2/1). V_C converts VIN in its first frame only, then
+delta sense alone. Delta sense takes LTC2946_CURRENT_CONV_US and each
+voltage LTC2946_VOLTAGE_CONV_US, so every result register refreshes on a
+known schedule from the CTRLA write that started the sequence.
+
+Begin() writes CTRLA and starts the model at that moment. Service()
+reads the measurement block once per new conversion of the followed
+channel, LTC2946_ALIGN_GUARD_US after its predicted end, and is cheap to
+call from loop() in between. Every read is checked against the model:
+one that finds no new conversion counts as a duplicate, and conversions
+overwritten before any read saw them count as missed. Account() books a
+read made elsewhere, e.g. a plain ReadVIN() poll, in the same counters.
+
+The model free-runs from the CTRLA write, so any error of the device's
+internal time base accumulates. Call Begin() again now and then on long
+runs, or widen the guard.
+*/
+
+#ifndef LTC2946_ALIGNED_H
+#define LTC2946_ALIGNED_H
+
+#include "LTC2946.h"
+
+#define LTC2946_ALIGN_GUARD_US      50      //!< Read this long after the predicted end of a conversion
+
+//! Read accounting against the conversion model
+struct LTC2946_AlignStats {
+    uint32_t reads;             //!< Reads booked by Service() or Account()
+    uint32_t conversions;       //!< Conversions of the channel completed up to the last read
+    uint32_t duplicates;        //!< Reads that found no new conversion
+    uint32_t missed;            //!< Conversions overwritten before any read saw them
+};
+
+class LTC2946_Aligned {
+public:
+    LTC2946_Aligned(LTC2946 &device,    //! <Device to read>
+                    LTC2946_Bus &bus    //! <Bus the device sits on, for its time base>
+                   );
+
+    //! Write CTRLA, which restarts the conversion sequence, and follow one channel from now on.
+    //! @return false if the write failed. No read is scheduled then (UntilDueUs() is 0xFFFFFFFF) until Begin() succeeds.
+    bool Begin(uint8_t ctrla,   //!< Continuous channel configuration, e.g. LTC2946_CHANNEL_CONFIG_V_C_3|LTC2946_SENSE_PLUS
+               uint8_t channel  //!< LTC2946_DELTA_SENSE (current and power), LTC2946_VDD or LTC2946_SENSE_PLUS (VIN), LTC2946_ADIN
+              );
+
+    //! Read the measurement block if a new conversion is due. ADIN is not in the block: when following
+    //! ADIN, time your own reads with UntilDueUs() and book them with Account().
+    //! @return true if it read without error.
+    bool Service(LTC2946_Measurement *data);
+    uint32_t UntilDueUs(); //! <Time until the next conversion is due to be read, 0 if it is due, 0xFFFFFFFF if none will come>
+    void Account(); //! <Book a read of the followed channel made outside Service(), at the current time>
+
+    void GetStats(LTC2946_AlignStats *stats); //! <Copy the read counters>
+    void ResetStats(); //! <Clear the read counters>
+
+    //! Mean steady-state conversion period of a channel under a CTRLA value, 0 if it is not converted after the first frame.
+    static uint32_t PeriodUs(uint8_t ctrla, uint8_t channel);
+
+private:
+    LTC2946 &device;
+    LTC2946_Bus &bus;
+    uint8_t ctrla = 0;
+    uint8_t channel = LTC2946_DELTA_SENSE;
+
+    uint32_t frame_start_us = 0;    //start of the frame the model is in
+    bool first_frame = true;        //V_C converts VIN in the first frame only
+    uint32_t completed_before = 0;  //conversions of the channel in earlier frames
+    uint32_t last_completed = 0;    //conversions completed at the last booked read
+    uint32_t due_us = 0;            //next read, predicted end of a conversion plus the guard
+    bool never = false;             //the channel is not converted any more
+    LTC2946_AlignStats stats = {};
+
+    void Book(uint32_t now); //! <Count a read at now against the model>
+    uint32_t Completed(uint32_t now); //! <Conversions of the channel completed by now, advancing the frame>
+    void Schedule(uint32_t now); //! <Set due_us after the next conversion end following now>
+
+    //! Conversions of a channel within one frame: count of them, end of the first, spacing, and the frame length
+    static void Layout(uint8_t ctrla, bool first, uint8_t channel, uint16_t *count, uint32_t *first_us, uint32_t *spacing_us, uint32_t *frame_us);
+};
+
+#endif  // LTC2946_ALIGNED_H
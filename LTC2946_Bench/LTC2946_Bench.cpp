@@ -0,0 +1,280 @@
+/*!
+LTC2946_Bench: bus-cost regression benchmark.
+
+Runs the public LTC2946 API against a simulated bus and device and counts,
+per call, the transactions, bytes, START, repeated START and STOP
+conditions it puts on the wire, plus the modeled wire time at the chosen
+SCL rate. Every call is compared with its recorded baseline at the
+default simulated clock; the program exits with status 1 if a hot-path
+call got more expensive. Cheaper calls are reported so the baseline can
+be tightened. Given another rate, the suite runs again at that rate for
+the wire times, without the check.
+
+A second table compares the trigger-to-data latency of one snapshot
+conversion along three completion paths: STATUS2 reads back to back (the
+original busy-wait), the PollSnapshot() state machine called from a busy
+loop, and the ADC-done alert edge calling SnapshotDone(). It also
+compares three channels snapshotted one after another, CTRLA restored by
+hand, with the pipelined snapshot sequence.
+
+Build and run on Linux from the library directory:
+    cmake -S . -B build && cmake --build build --target bench
+or run build/LTC2946_Bench [scl_hz] directly (default 100000).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "LTC2946_Sim.h"
+
+//! One benchmarked call and its recorded cost
+struct BenchCase {
+    const char *name;
+    bool hot;                   //Per-sample call: an increase fails the benchmark
+    void (*run)(LTC2946 &device);
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t starts;
+    uint32_t restarts;
+    uint32_t stops;
+};
+
+static LTC2946_Measurement bench_data;
+static uint8_t bench_block[LTC2946_MEAS_BLOCK_LEN];
+static uint8_t bench_map[LTC2946_REG_COUNT];
+
+static void RunSetContinuous(LTC2946 &device) {device.SetContinuous();}
+static void RunReadVIN(LTC2946 &device) {device.ReadVIN();}
+static void RunReadCurrent(LTC2946 &device) {device.ReadCurrent();}
+static void RunReadPower(LTC2946 &device) {device.ReadPower();}
+static void RunReadAll(LTC2946 &device) {device.ReadAll(&bench_data);}
+static void RunReadAllMap(LTC2946 &device) {device.ReadAll(&bench_data, bench_map);}
+
+static void RunStartRead(LTC2946 &device)
+{
+    device.StartRead(LTC2946_VIN_MSB_REG, 12);
+    device.Collect();
+}
+
+static void RunStartReadBlock(LTC2946 &device)
+{
+    LTC2946_Transfer xfer;
+
+    device.StartReadBlock(LTC2946_MEAS_BLOCK_START, bench_block, LTC2946_MEAS_BLOCK_LEN, &xfer);
+    while(!xfer.done) device.Poll();
+    device.FinishBlock(&xfer);
+}
+
+static void RunUpdateConfig(LTC2946 &device) {device.UpdateConfig(LTC2946_CTRLA_REG, LTC2946_CTRLA_OFFSET_MASK, LTC2946_OFFSET_CAL_16);}
+
+static void RunSetThresholds(LTC2946 &device)
+{
+    LTC2946_Thresholds thresholds = {0x800000, 0x000100, 0x0800, 0x0010, 0x0C00, 0x0100, 0x0FFF, 0x0000};
+
+    device.SetThresholds(&thresholds);
+}
+
+static void RunVerifyConfig(LTC2946 &device) {device.VerifyConfig();}
+static void RunRestoreConfig(LTC2946 &device) {device.RestoreConfig();}
+
+static void RunSnapshotVIN(LTC2946 &device)
+{
+    device.SetSnapShot();
+    device.ReadVIN();
+}
+
+static void RunSnapshotCurrent(LTC2946 &device)
+{
+    device.SetSnapShot();
+    device.ReadCurrent();
+}
+
+static void RunSnapshotPower(LTC2946 &device)
+{
+    device.SetSnapShot();
+    device.ReadPower();
+}
+
+static const uint8_t bench_sequence[] = {LTC2946_SENSE_PLUS, LTC2946_DELTA_SENSE, LTC2946_ADIN};
+static uint16_t bench_codes[sizeof(bench_sequence)];
+
+static void RunSnapshotSequence(LTC2946 &device) {device.ReadSnapshotSequence(bench_sequence, sizeof(bench_sequence), bench_codes);}
+
+static void RunSnapshotAll(LTC2946 &device)
+{
+    device.SetSnapShot();
+    device.ReadSnapshotAll(&bench_data);
+}
+
+//Baselines at the time of writing. Lower them when a change makes a call cheaper.
+static const BenchCase bench_cases[] = {
+    //name                  hot    run                 trans bytes start rstart stop
+    {"SetContinuous",       false, RunSetContinuous,       1,    3,    1,    0,    1},
+    {"ReadVIN",             true,  RunReadVIN,             1,    5,    1,    1,    1},
+    {"ReadCurrent",         true,  RunReadCurrent,         1,    5,    1,    1,    1},
+    {"ReadPower",           true,  RunReadPower,           1,    6,    1,    1,    1},
+    {"ReadAll",             true,  RunReadAll,             1,   30,    1,    1,    1},
+    {"ReadAll(map)",        false, RunReadAllMap,          1,   71,    1,    1,    1},
+    {"StartRead+Collect",   true,  RunStartRead,           1,    5,    1,    1,    1},
+    {"StartReadBlock",      true,  RunStartReadBlock,      1,   30,    1,    1,    1},
+    {"UpdateConfig",        false, RunUpdateConfig,        1,    3,    1,    0,    1},
+    {"SetThresholds",       false, RunSetThresholds,       4,   26,    4,    0,    4},
+    {"VerifyConfig",        false, RunVerifyConfig,        1,   71,    1,    1,    1},
+    {"RestoreConfig",       false, RunRestoreConfig,       6,   37,    6,    0,    6},
+    {"Snapshot ReadVIN",    true,  RunSnapshotVIN,         3,   12,    3,    2,    3},
+    {"Snapshot ReadCurrent",true,  RunSnapshotCurrent,     3,   12,    3,    2,    3},
+    //Snapshot power used to return nothing; it is now two snapshots, VIN and delta sense
+    {"Snapshot ReadPower",  true,  RunSnapshotPower,       6,   24,    6,    4,    6},
+    {"ReadSnapshotAll",     true,  RunSnapshotAll,         6,   24,    6,    4,    6},
+    {"Snapshot sequence x3",true,  RunSnapshotSequence,   10,   39,   10,    6,   10},
+};
+
+//! Run every case on a fresh bus and device. Returns the number of hot-path regressions if check is set.
+static uint8_t RunSuite(uint32_t scl_hz, bool check)
+{
+    LTC2946_SimBus bus;
+    LTC2946_SimDevice sim(0x6F);
+    LTC2946 device(bus, 0x6F);
+    LTC2946_BusCost cost;
+    const BenchCase *c;
+    uint8_t i, regressions = 0;
+    bool worse;
+
+    bus.Attach(sim);
+    bus.SetClock(scl_hz);
+    sim.delta_sense_code = 0x400;
+    sim.sense_plus_code = 0x600;
+    sim.vdd_code = 0x500;
+    device.Setup();
+
+    printf("SCL %lu Hz%s\n", (unsigned long)scl_hz, check ? ", checked against baseline" : "");
+    printf("%-21s %5s %5s %5s %6s %5s %8s\n", "call", "trans", "bytes", "start", "rstart", "stop", "wire_us");
+    for(i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++)
+    {
+        c = &bench_cases[i];
+
+        bus.ResetCost();
+        c->run(device);
+        bus.GetCost(&cost);
+
+        worse = cost.transactions > c->transactions || cost.bytes > c->bytes || cost.starts > c->starts ||
+                cost.restarts > c->restarts || cost.stops > c->stops;
+        printf("%-21s %5u %5u %5u %6u %5u %8u%s\n", c->name, cost.transactions, cost.bytes, cost.starts,
+               cost.restarts, cost.stops, cost.wire_us,
+               !check ? "" : worse ? (c->hot ? "  REGRESSION" : "  above baseline") :
+               (cost.bytes < c->bytes || cost.transactions < c->transactions) ? "  below baseline" : "");
+        if(check && worse && c->hot) regressions++;
+    }
+    return(regressions);
+}
+
+//Snapshot completion paths
+#define PATH_BUSY_WAIT  0
+#define PATH_POLL       1
+#define PATH_ALERT      2
+
+//! One snapshot along a completion path. Returns the trigger-to-data latency; status_reads gets the STATUS2 reads.
+static uint32_t RunLatency(LTC2946_SimBus &bus, LTC2946 &device, uint8_t channel, uint8_t path, uint32_t *status_reads)
+{
+    uint8_t result_reg = (channel == LTC2946_DELTA_SENSE) ? LTC2946_DELTA_SENSE_MSB_REG : LTC2946_VIN_MSB_REG;
+    LTC2946_SnapshotStats stats;
+    uint32_t start = bus.Micros();
+
+    *status_reads = 0;
+    device.TriggerSnapshot(channel);
+
+    if(path == PATH_BUSY_WAIT)
+    {
+        do
+        {
+            device.StartRead(LTC2946_STATUS2_REG, 8);
+            (*status_reads)++;
+        }
+        while(device.Collect() & LTC2946_STATUS2_ADC_BUSY);
+
+        device.StartRead(result_reg, 12);
+        device.Collect();
+        return(bus.Micros() - start);
+    }
+
+    //loop() with nothing else to do: one microsecond per pass
+    while(device.PollSnapshot() == LTC2946_SNAPSHOT_PENDING)
+    {
+        bus.Advance(1);
+        if(path == PATH_ALERT && bus.Alert()) device.SnapshotDone();
+    }
+    device.ReadSnapshot();
+
+    device.GetSnapshotStats(&stats);
+    *status_reads = stats.last_status_reads;
+    return(bus.Micros() - start);
+}
+
+//! Print trigger-to-data latency of every completion path for VIN and delta sense snapshots
+static void LatencySuite(uint32_t scl_hz)
+{
+    static const char *path_name[] = {"busy-wait", "PollSnapshot", "ADC-done alert"};
+    static const uint8_t channel[] = {LTC2946_SENSE_PLUS, LTC2946_DELTA_SENSE};
+    static const char *channel_name[] = {"VIN", "delta sense"};
+    LTC2946_SimBus bus;
+    LTC2946_SimDevice sim(0x6F);
+    LTC2946 device(bus, 0x6F);
+    uint32_t latency_us, status_reads, start;
+    uint8_t c, path, ctrla;
+
+    bus.Attach(sim);
+    bus.SetClock(scl_hz);
+    device.Setup();
+
+    printf("\nSnapshot latency, SCL %lu Hz\n", (unsigned long)scl_hz);
+    printf("%-12s %-15s %10s %12s\n", "channel", "path", "latency_us", "status_reads");
+    for(c = 0; c < sizeof(channel); c++)
+    {
+        for(path = PATH_BUSY_WAIT; path <= PATH_ALERT; path++)
+        {
+            if(path == PATH_ALERT) device.EnableSnapshotAlert();
+            latency_us = RunLatency(bus, device, channel[c], path, &status_reads);
+            if(path == PATH_ALERT) device.DisableSnapshotAlert();
+
+            printf("%-12s %-15s %10lu %12lu\n", channel_name[c], path_name[path], (unsigned long)latency_us, (unsigned long)status_reads);
+        }
+    }
+
+    //Three channels, one complete snapshot after another
+    ctrla = device.ReadConfig(LTC2946_CTRLA_REG);
+    start = bus.Micros();
+    for(c = 0; c < sizeof(bench_sequence); c++)
+    {
+        device.TriggerSnapshot(bench_sequence[c]);
+        while(device.PollSnapshot() == LTC2946_SNAPSHOT_PENDING) bus.Advance(1);
+        device.ReadSnapshot();
+    }
+    device.WriteConfig(LTC2946_CTRLA_REG, ctrla);
+    printf("%-12s %-15s %10lu\n", "3 channels", "serialized", (unsigned long)(bus.Micros() - start));
+
+    start = bus.Micros();
+    device.StartSnapshotSequence(bench_sequence, sizeof(bench_sequence));
+    while(device.PollSnapshotSequence() == LTC2946_SNAPSHOT_PENDING) bus.Advance(1);
+    printf("%-12s %-15s %10lu\n", "3 channels", "sequence", (unsigned long)(bus.Micros() - start));
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t scl_hz = (argc > 1) ? strtoul(argv[1], NULL, 0) : LTC2946_SIM_CLOCK_HZ;
+    uint8_t regressions;
+
+    //Status polling depends on the clock, so the baseline holds at LTC2946_SIM_CLOCK_HZ only
+    regressions = RunSuite(LTC2946_SIM_CLOCK_HZ, true);
+    if(scl_hz != LTC2946_SIM_CLOCK_HZ)
+    {
+        printf("\n");
+        RunSuite(scl_hz, false);
+    }
+    LatencySuite(scl_hz);
+
+    if(regressions != 0)
+    {
+        printf("%u hot-path call(s) cost more bus traffic than their baseline\n", regressions);
+        return(1);
+    }
+    return(0);
+}
@@ -0,0 +1,109 @@
+/*!
+LTC2946_Bus: transport used by the LTC2946 class.
+
+One bus object exists per physical I2C bus and is shared by every LTC2946
+on that bus. The LTC2946 class captures a reference to it in its constructor,
+so each transaction takes a single code path regardless of which wire the
+device sits on.
+
+Register data is transferred MSB first, exactly as it appears in the
+LTC2946 register map. Multi-byte accesses rely on the LTC2946 auto-increment
+of the register pointer.
+*/
+
+#ifndef LTC2946_BUS_H
+#define LTC2946_BUS_H
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+typedef uint8_t byte;
+#endif
+
+//! Transaction status. 0-4 match the Wire/i2c_t3 endTransmission() codes.
+#define LTC2946_OK                  0   //!< Acknowledged, all bytes transferred
+#define LTC2946_ERR_LENGTH          1   //!< Data too long for the transmit buffer
+#define LTC2946_ERR_ADDR_NACK       2   //!< NACK on the address byte
+#define LTC2946_ERR_DATA_NACK       3   //!< NACK on a command or data byte
+#define LTC2946_ERR_OTHER           4   //!< Other bus error, e.g. arbitration lost
+#define LTC2946_ERR_TIMEOUT         5   //!< Transaction timed out
+#define LTC2946_ERR_SHORT_READ      6   //!< Fewer bytes received than requested
+#define LTC2946_ERR_QUARANTINED     7   //!< Not attempted: the device is quarantined after repeated failures
+
+//! Background register read. The caller owns the descriptor and the data buffer until done is raised.
+struct LTC2946_Transfer {
+    uint8_t address;            //!< I2C address of the LTC2946
+    uint8_t adc_command;        //!< The "command byte" of the first register
+    uint8_t *data;              //!< Buffer for len bytes, MSB first
+    uint8_t len;                //!< Number of bytes to read
+    volatile int8_t ack;        //!< Result, valid once done. LTC2946_OK or LTC2946_ERR_*
+    volatile bool done;         //!< Raised by the bus when the transfer has finished
+};
+
+class LTC2946_Bus {
+public:
+    virtual ~LTC2946_Bus() {}
+
+    virtual void Begin() = 0; //! <Initializes the bus, call in Setup loop>
+
+    //! Write len bytes starting at register adc_command.
+    //! @return LTC2946_OK or LTC2946_ERR_*
+    virtual int8_t Write(uint8_t address,       //!< I2C address of the LTC2946
+                         uint8_t adc_command,   //!< The "command byte" of the first register
+                         const uint8_t *data,   //!< Bytes to write, MSB first
+                         uint8_t len            //!< Number of bytes to write
+                        ) = 0;
+
+    //! Set the register pointer to adc_command and read len bytes after a repeated start.
+    //! @return LTC2946_OK or LTC2946_ERR_*. LTC2946_ERR_SHORT_READ if fewer than len bytes arrived.
+    virtual int8_t Read(uint8_t address,        //!< I2C address of the LTC2946
+                        uint8_t adc_command,    //!< The "command byte" of the first register
+                        uint8_t *data,          //!< Buffer for len bytes, MSB first
+                        uint8_t len             //!< Number of bytes to read
+                       ) = 0;
+
+    //! Plain read of len bytes with no register pointer write, e.g. from the Alert Response Address.
+    //! @return LTC2946_OK or LTC2946_ERR_*
+    virtual int8_t Receive(uint8_t address,     //!< I2C address to read from
+                           uint8_t *data,       //!< Buffer for len bytes
+                           uint8_t len          //!< Number of bytes to read
+                          ) = 0;
+
+    //! Start a background read described by xfer. Clears xfer->done.
+    //! @return false if another background read is still in flight on this bus.
+    virtual bool StartRead(LTC2946_Transfer *xfer) = 0;
+
+    //! Advance the background read in flight, raising its done flag on completion.
+    //! Call from loop(); returns immediately when nothing is in flight.
+    virtual void Poll() = 0;
+
+    //! True while a background read is in flight.
+    virtual bool Busy() = 0;
+
+    //! Timeout applied to each following transaction, in microseconds. 0 disables the timeout.
+    //! A background read takes its deadline from the timeout set when it starts: past it, Poll()
+    //! finishes the read with LTC2946_ERR_TIMEOUT. A blocking transaction waits at most one timeout
+    //! for a background read still in flight, then abandons it the same way.
+    virtual void SetTimeout(uint32_t timeout_us) = 0;
+
+    //! Busy wait, used for retry backoff.
+    virtual void Delay(uint32_t us) = 0;
+
+    //! Set the SCL rate, applied now and on every Begin().
+    //! @return The rate actually set, or 0 if the transport cannot change it.
+    virtual uint32_t SetClock(uint32_t hz) = 0;
+
+    //! True if SDA is held low with the bus idle, i.e. a slave is stuck mid-byte.
+    virtual bool BusStuck() = 0;
+
+    //! Clock SCL (up to nine pulses) until SDA is released, then issue a STOP.
+    //! Any background read in flight is abandoned. Returns true if the bus is free afterwards.
+    virtual bool Recover() = 0;
+
+    //! Time base used for scheduling and statistics on this bus, in microseconds. Wraps like micros().
+    virtual uint32_t Micros() = 0;
+};
+
+#endif  // LTC2946_BUS_H
@@ -0,0 +1,176 @@
+/*!
+LTC2946_BusManager: earliest-deadline-first scheduling of many LTC2946 on one bus.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "LTC2946_BusManager.h"
+
+LTC2946_BusManager::LTC2946_BusManager(LTC2946_Bus &bus) : bus(bus) //!constructor
+{
+}
+
+int8_t LTC2946_BusManager::Add(LTC2946 &device, float rate_hz)
+{
+    Slot *slot;
+
+    if(slot_count >= LTC2946_BUS_MAX_DEVICES) return(-1);
+
+    slot = &slots[slot_count];
+    memset(slot, 0, sizeof(Slot));
+    slot->device = &device;
+    slot->release_us = bus.Micros();
+    slot->period_us = PeriodUs(rate_hz);
+
+    return(slot_count++);
+}
+
+void LTC2946_BusManager::SetRate(uint8_t slot, float rate_hz)
+{
+    if(slot >= slot_count) return;
+    slots[slot].period_us = PeriodUs(rate_hz);
+}
+
+uint32_t LTC2946_BusManager::PeriodUs(float rate_hz)
+{
+    return((rate_hz > 0) ? (uint32_t)(1000000.0 / rate_hz) : 1);
+}
+
+uint8_t LTC2946_BusManager::Count()
+{
+    return(slot_count);
+}
+
+void LTC2946_BusManager::Service()
+{
+    uint32_t now;
+    uint32_t deadline = 0;
+    int8_t next = -1;
+    uint8_t i;
+
+    //Sample on the wire: nothing else can be scheduled until it lands
+    if(active >= 0)
+    {
+        bus.Poll();
+        if(!xfer.done) return;
+
+        Complete(slots[active], bus.Micros());
+        active = -1;
+    }
+
+    //Earliest deadline among the released samples
+    now = bus.Micros();
+    for(i = 0; i < slot_count; i++)
+    {
+        if((int32_t)(now - slots[i].release_us) < 0 || slots[i].device->Quarantined()) continue;
+
+        if(next < 0 || (int32_t)(slots[i].release_us + slots[i].period_us - deadline) < 0)
+        {
+            next = i;
+            deadline = slots[i].release_us + slots[i].period_us;
+        }
+    }
+    if(next < 0) return;
+
+    if(slots[next].device->StartReadBlock(LTC2946_MEAS_BLOCK_START, block, LTC2946_MEAS_BLOCK_LEN, &xfer))
+    {
+        active = next;
+    }
+}
+
+void LTC2946_BusManager::Complete(Slot &slot, uint32_t now)
+{
+    uint32_t interval, deviation;
+
+    if(slot.device->FinishBlock(&xfer) != LTC2946_OK)
+    {
+        slot.errors++;
+    }
+    else
+    {
+        slot.device->DecodeAll(block, &slot.data);
+        slot.fresh = true;
+
+        if(slot.samples == 0)
+        {
+            slot.first_us = now;
+        }
+        else
+        {
+            interval = now - slot.last_us;
+            deviation = (interval > slot.period_us) ? interval - slot.period_us : slot.period_us - interval;
+            slot.jitter_sum_us += deviation;
+            if(deviation > slot.max_jitter_us) slot.max_jitter_us = deviation;
+        }
+        slot.last_us = now;
+        slot.samples++;
+    }
+
+    //Late sample, then every period that passed without one
+    if((int32_t)(now - (slot.release_us + slot.period_us)) > 0) slot.overruns++;
+    slot.release_us += slot.period_us;
+    while((int32_t)(now - (slot.release_us + slot.period_us)) >= 0)
+    {
+        slot.release_us += slot.period_us;
+        slot.overruns++;
+    }
+}
+
+bool LTC2946_BusManager::Latest(uint8_t slot, LTC2946_Measurement *data)
+{
+    bool fresh;
+
+    if(slot >= slot_count) return(false);
+
+    *data = slots[slot].data;
+    fresh = slots[slot].fresh;
+    slots[slot].fresh = false;
+    return(fresh);
+}
+
+void LTC2946_BusManager::Stats(uint8_t slot, LTC2946_DeviceStats *stats)
+{
+    Slot *s;
+
+    memset(stats, 0, sizeof(LTC2946_DeviceStats));
+    if(slot >= slot_count) return;
+    s = &slots[slot];
+
+    stats->samples = s->samples;
+    stats->errors = s->errors;
+    stats->overruns = s->overruns;
+    stats->max_jitter_us = s->max_jitter_us;
+    if(s->samples > 1)
+    {
+        stats->jitter_us = s->jitter_sum_us / (s->samples - 1);
+        if(s->last_us != s->first_us) stats->rate_hz = (float)(s->samples - 1) * 1000000.0 / (float)(s->last_us - s->first_us);
+    }
+}
+
+void LTC2946_BusManager::ResetStats()
+{
+    uint8_t i;
+
+    for(i = 0; i < slot_count; i++)
+    {
+        slots[i].samples = 0;
+        slots[i].errors = 0;
+        slots[i].overruns = 0;
+        slots[i].jitter_sum_us = 0;
+        slots[i].max_jitter_us = 0;
+    }
+}
+
+uint32_t LTC2946_BusManager::Samples()
+{
+    uint32_t samples = 0;
+    uint8_t i;
+
+    for(i = 0; i < slot_count; i++) samples += slots[i].samples;
+    return(samples);
+}
+
+LTC2946_Bus &LTC2946_BusManager::Bus()
+{
+    return(bus);
+}
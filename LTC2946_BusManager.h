@@ -0,0 +1,81 @@
+/*!
+LTC2946_BusManager: earliest-deadline-first scheduling of many LTC2946 on one bus.
+
+Every device on the bus is added with its own target sample rate. Each
+sample is one burst read of the measurement block (see ReadAll()), run as a
+background read so Service() never blocks on the wire. Whenever the bus is
+free, Service() starts the released sample with the earliest deadline, so
+fast rails are not starved by slow ones.
+
+Per device the manager reports achieved rate, sample interval jitter and
+overruns (samples completed after their deadline, or skipped outright).
+*/
+
+#ifndef LTC2946_BUSMANAGER_H
+#define LTC2946_BUSMANAGER_H
+
+#include "LTC2946.h"
+
+#define LTC2946_BUS_MAX_DEVICES     9   //!< One per valid strap address
+
+//! Per-device scheduling statistics
+struct LTC2946_DeviceStats {
+    uint32_t samples;           //!< Completed samples
+    uint32_t errors;            //!< Samples that failed on the bus
+    uint32_t overruns;          //!< Samples completed after their deadline, plus releases skipped entirely
+    float rate_hz;              //!< Achieved sample rate between the first and last sample
+    uint32_t jitter_us;         //!< Mean absolute deviation of the sample interval from the target period
+    uint32_t max_jitter_us;     //!< Largest deviation of the sample interval from the target period
+};
+
+class LTC2946_BusManager {
+public:
+    LTC2946_BusManager(LTC2946_Bus &bus //! <Bus shared by every managed device>
+                      );
+
+    //! Put a device under the manager's control.
+    //! @return The device slot, or -1 if LTC2946_BUS_MAX_DEVICES are already managed.
+    int8_t Add(LTC2946 &device, //!< Device on this manager's bus
+               float rate_hz    //!< Target sample rate
+              );
+    void SetRate(uint8_t slot, float rate_hz); //! <Change the target rate of a device>
+    uint8_t Count(); //! <Number of managed devices>
+
+    void Service(); //! <Advance the schedule, call from loop() as often as possible>
+
+    bool Latest(uint8_t slot, LTC2946_Measurement *data); //! <Copy the last sample of a device. Returns true if it is new since the last call>
+    void Stats(uint8_t slot, LTC2946_DeviceStats *stats); //! <Scheduling statistics of a device>
+    void ResetStats(); //! <Clear statistics of every device>
+    uint32_t Samples(); //! <Completed samples over every device on the bus>
+    LTC2946_Bus &Bus(); //! <Bus this manager schedules>
+
+private:
+    struct Slot {
+        LTC2946 *device;
+        uint32_t period_us;
+        uint32_t release_us;        //start of the current period; its deadline is release_us + period_us
+        LTC2946_Measurement data;
+        bool fresh;
+
+        uint32_t samples;
+        uint32_t errors;
+        uint32_t overruns;
+        uint32_t first_us;
+        uint32_t last_us;
+        uint32_t jitter_sum_us;
+        uint32_t max_jitter_us;
+    };
+
+    LTC2946_Bus &bus;
+    Slot slots[LTC2946_BUS_MAX_DEVICES];
+    uint8_t slot_count = 0;
+
+    int8_t active = -1; //slot with a sample on the wire, -1 if none
+    LTC2946_Transfer xfer;
+    uint8_t block[LTC2946_MEAS_BLOCK_LEN];
+
+    void Complete(Slot &slot, uint32_t now); //! <Book a finished sample and release the next period>
+    static uint32_t PeriodUs(float rate_hz);
+};
+
+#endif  // LTC2946_BUSMANAGER_H
@@ -0,0 +1,347 @@
+/*!
+LTC2946_BusTrace: golden bus-trace capture and deterministic replay.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "LTC2946_BusTrace.h"
+
+LTC2946_Capture::LTC2946_Capture(LTC2946_Bus &bus, uint8_t *buffer, uint32_t size) : bus(bus), buffer(buffer), size(size) //!constructor
+{
+    Clear();
+}
+
+const uint8_t *LTC2946_Capture::Data()
+{
+    return(buffer);
+}
+
+uint32_t LTC2946_Capture::Size()
+{
+    return(used);
+}
+
+uint32_t LTC2946_Capture::Dropped()
+{
+    return(dropped);
+}
+
+void LTC2946_Capture::Clear()
+{
+    used = 0;
+    dropped = 0;
+    last_us = bus.Micros();
+    if(size < LTC2946_BUSTRACE_HEADER_LEN) return;
+
+    memcpy(buffer, LTC2946_BUSTRACE_MAGIC, 4);
+    buffer[4] = LTC2946_BUSTRACE_VERSION;
+    used = LTC2946_BUSTRACE_HEADER_LEN;
+}
+
+void LTC2946_Capture::Begin()
+{
+    bus.Begin();
+}
+
+int8_t LTC2946_Capture::Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len)
+{
+    int8_t status = bus.Write(address, adc_command, data, len);
+
+    RecordPending();
+    Record(LTC2946_BUSTRACE_OP_WRITE, address, adc_command, data, len, status);
+    return(status);
+}
+
+int8_t LTC2946_Capture::Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len)
+{
+    int8_t status = bus.Read(address, adc_command, data, len);
+
+    RecordPending();
+    Record(LTC2946_BUSTRACE_OP_READ, address, adc_command, data, len, status);
+    return(status);
+}
+
+int8_t LTC2946_Capture::Receive(uint8_t address, uint8_t *data, uint8_t len)
+{
+    int8_t status = bus.Receive(address, data, len);
+
+    RecordPending();
+    Record(LTC2946_BUSTRACE_OP_RECEIVE, address, 0, data, len, status);
+    return(status);
+}
+
+bool LTC2946_Capture::StartRead(LTC2946_Transfer *xfer)
+{
+    if(!bus.StartRead(xfer)) return(false);
+
+    xfer_pending = xfer;
+    return(true);
+}
+
+void LTC2946_Capture::Poll()
+{
+    bus.Poll();
+    RecordPending();
+}
+
+bool LTC2946_Capture::Busy()
+{
+    return(bus.Busy());
+}
+
+void LTC2946_Capture::SetTimeout(uint32_t timeout_us)
+{
+    bus.SetTimeout(timeout_us);
+}
+
+void LTC2946_Capture::Delay(uint32_t us)
+{
+    bus.Delay(us);
+}
+
+uint32_t LTC2946_Capture::SetClock(uint32_t hz)
+{
+    return(bus.SetClock(hz));
+}
+
+bool LTC2946_Capture::BusStuck()
+{
+    return(bus.BusStuck());
+}
+
+bool LTC2946_Capture::Recover()
+{
+    bool ok = bus.Recover();
+
+    RecordPending();
+    return(ok);
+}
+
+uint32_t LTC2946_Capture::Micros()
+{
+    return(bus.Micros());
+}
+
+// A blocking transaction drains the background read first, so it is recorded ahead of it
+void LTC2946_Capture::RecordPending()
+{
+    LTC2946_Transfer *xfer = xfer_pending;
+
+    if(xfer == NULL || !xfer->done) return;
+
+    xfer_pending = NULL;
+    Record(LTC2946_BUSTRACE_OP_READ, xfer->address, xfer->adc_command, xfer->data, xfer->len, xfer->ack);
+}
+
+void LTC2946_Capture::Record(uint8_t op, uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len, int8_t status)
+{
+    uint32_t now = bus.Micros();
+    uint32_t delta = now - last_us;
+    uint8_t varint[5];
+    uint8_t n = 0;
+
+    do
+    {
+        varint[n++] = (delta & 0x7F) | (delta > 0x7F ? 0x80 : 0);
+        delta >>= 7;
+    }
+    while(delta != 0);
+
+    if(used + 5 + n + len > size)
+    {
+        dropped++;
+        return;
+    }
+
+    buffer[used++] = op;
+    buffer[used++] = address;
+    buffer[used++] = adc_command;
+    buffer[used++] = len;
+    buffer[used++] = (uint8_t)status;
+    memcpy(&buffer[used], varint, n);
+    used += n;
+    memcpy(&buffer[used], data, len);
+    used += len;
+    last_us = now;
+}
+
+LTC2946_Replay::LTC2946_Replay(const uint8_t *trace, uint32_t size) : trace(trace), size(size) //!constructor
+{
+    Rewind();
+}
+
+bool LTC2946_Replay::Valid()
+{
+    return(size >= LTC2946_BUSTRACE_HEADER_LEN && memcmp(trace, LTC2946_BUSTRACE_MAGIC, 4) == 0 && trace[4] == LTC2946_BUSTRACE_VERSION);
+}
+
+bool LTC2946_Replay::Done()
+{
+    return(!Valid() || pos >= size);
+}
+
+void LTC2946_Replay::Rewind()
+{
+    pos = LTC2946_BUSTRACE_HEADER_LEN;
+    xfer_active = NULL;
+}
+
+uint32_t LTC2946_Replay::Served()
+{
+    return(served);
+}
+
+uint32_t LTC2946_Replay::Divergences()
+{
+    return(divergences);
+}
+
+void LTC2946_Replay::Begin()
+{
+}
+
+int8_t LTC2946_Replay::Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len)
+{
+    Poll();
+    return(Serve(LTC2946_BUSTRACE_OP_WRITE, address, adc_command, NULL, data, len));
+}
+
+int8_t LTC2946_Replay::Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len)
+{
+    Poll();
+    return(Serve(LTC2946_BUSTRACE_OP_READ, address, adc_command, data, NULL, len));
+}
+
+int8_t LTC2946_Replay::Receive(uint8_t address, uint8_t *data, uint8_t len)
+{
+    Poll();
+    return(Serve(LTC2946_BUSTRACE_OP_RECEIVE, address, 0, data, NULL, len));
+}
+
+// Background reads complete on the next Poll()
+bool LTC2946_Replay::StartRead(LTC2946_Transfer *xfer)
+{
+    if(xfer_active != NULL) return(false);
+
+    xfer->done = false;
+    xfer_active = xfer;
+    return(true);
+}
+
+void LTC2946_Replay::Poll()
+{
+    LTC2946_Transfer *xfer = xfer_active;
+
+    if(xfer == NULL) return;
+
+    xfer_active = NULL;
+    xfer->ack = Serve(LTC2946_BUSTRACE_OP_READ, xfer->address, xfer->adc_command, xfer->data, NULL, xfer->len);
+    xfer->done = true;
+}
+
+bool LTC2946_Replay::Busy()
+{
+    return(xfer_active != NULL);
+}
+
+void LTC2946_Replay::SetTimeout(uint32_t /*timeout_us*/)
+{
+}
+
+// Recorded timestamps already include the time spent waiting
+void LTC2946_Replay::Delay(uint32_t /*us*/)
+{
+}
+
+uint32_t LTC2946_Replay::SetClock(uint32_t hz)
+{
+    return(hz);
+}
+
+bool LTC2946_Replay::BusStuck()
+{
+    return(false);
+}
+
+bool LTC2946_Replay::Recover()
+{
+    return(true);
+}
+
+uint32_t LTC2946_Replay::Micros()
+{
+    return(now_us);
+}
+
+bool LTC2946_Replay::Peek(uint8_t *op, uint8_t *address, uint8_t *adc_command, uint8_t *len)
+{
+    if(Done() || pos + 5 > size) return(false);
+
+    *op = trace[pos];
+    *address = trace[pos + 1];
+    *adc_command = trace[pos + 2];
+    *len = trace[pos + 3];
+    return(true);
+}
+
+void LTC2946_Replay::Skip()
+{
+    uint32_t payload, delta;
+
+    if(!Locate(&payload, &delta))
+    {
+        pos = size;
+        return;
+    }
+    now_us += delta;
+    pos = payload + trace[pos + 3];
+}
+
+int8_t LTC2946_Replay::Serve(uint8_t op, uint8_t address, uint8_t adc_command, uint8_t *data, const uint8_t *written, uint8_t len)
+{
+    uint32_t payload, delta;
+    int8_t status;
+
+    if(Done() || pos + 5 > size ||
+       trace[pos] != op || trace[pos + 1] != address || trace[pos + 2] != adc_command || trace[pos + 3] != len)
+    {
+        divergences++;
+        return(LTC2946_ERR_OTHER);
+    }
+    if(!Locate(&payload, &delta))
+    {
+        divergences++;
+        pos = size;
+        return(LTC2946_ERR_OTHER);
+    }
+    status = (int8_t)trace[pos + 4];
+
+    if(data != NULL) memcpy(data, &trace[payload], len);
+    if(written != NULL && memcmp(written, &trace[payload], len) != 0) divergences++;
+
+    now_us += delta;
+    pos = payload + len;
+    served++;
+    return(status);
+}
+
+bool LTC2946_Replay::Locate(uint32_t *payload, uint32_t *delta)
+{
+    uint32_t at = pos + 5;
+    uint8_t shift = 0;
+
+    if(pos + 5 > size) return(false);
+
+    //LEB128 time delta
+    *delta = 0;
+    do
+    {
+        if(at >= size || shift > 28) return(false);
+        *delta |= (uint32_t)(trace[at] & 0x7F) << shift;
+        shift += 7;
+    }
+    while(trace[at++] & 0x80);
+
+    *payload = at;
+    return(at + trace[pos + 3] <= size);
+}
@@ -0,0 +1,124 @@
+/*!
+LTC2946_BusTrace: golden bus-trace capture and deterministic replay.
+
+LTC2946_Capture wraps any LTC2946_Bus and records every transaction that
+passes through it into a caller-supplied buffer: blocking writes, reads
+and plain receives, and background reads when they complete. Save the
+buffer (Data(), Size()) however the target allows, e.g. over Serial or
+to SD, and load it on a host.
+
+LTC2946_Replay is an LTC2946_Bus that serves a captured trace back to
+the driver. Each transaction the driver issues must match the next
+record in address, register, direction and length; it then gets the
+recorded status and read data. A transaction that does not match counts
+as a divergence and fails with LTC2946_ERR_OTHER without consuming the
+record. Micros() follows the recorded timestamps and Delay() costs no
+real time, so a trace replays as fast as the host can decode it.
+
+Trace format, all integers little endian:
+    header  "L46T", version (1 byte)
+    record  op (1 byte: 0 write, 1 read, 2 receive)
+            address, adc_command, len (1 byte each), status (int8)
+            time since the previous record in us (LEB128, 1-5 bytes)
+            len payload bytes: data written, or data received
+A typical 27-byte measurement block read costs 34 bytes of trace.
+*/
+
+#ifndef LTC2946_BUSTRACE_H
+#define LTC2946_BUSTRACE_H
+
+#include "LTC2946_Bus.h"
+
+#define LTC2946_BUSTRACE_MAGIC      "L46T"
+#define LTC2946_BUSTRACE_VERSION    1
+#define LTC2946_BUSTRACE_HEADER_LEN 5
+
+#define LTC2946_BUSTRACE_OP_WRITE   0
+#define LTC2946_BUSTRACE_OP_READ    1
+#define LTC2946_BUSTRACE_OP_RECEIVE 2
+
+class LTC2946_Capture : public LTC2946_Bus {
+public:
+    LTC2946_Capture(LTC2946_Bus &bus,    //! <Bus that carries the traffic>
+                    uint8_t *buffer,     //! <Trace storage>
+                    uint32_t size        //! <Size of buffer in bytes>
+                   );
+
+    const uint8_t *Data(); //! <Trace recorded so far>
+    uint32_t Size(); //! <Bytes of trace recorded so far>
+    uint32_t Dropped(); //! <Transactions not recorded because the buffer was full>
+    void Clear(); //! <Restart the trace>
+
+    void Begin();
+    int8_t Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len);
+    int8_t Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len);
+    int8_t Receive(uint8_t address, uint8_t *data, uint8_t len);
+    bool StartRead(LTC2946_Transfer *xfer);
+    void Poll();
+    bool Busy();
+    void SetTimeout(uint32_t timeout_us);
+    void Delay(uint32_t us);
+    uint32_t SetClock(uint32_t hz);
+    bool BusStuck();
+    bool Recover();
+    uint32_t Micros();
+
+private:
+    LTC2946_Bus &bus;
+    uint8_t *buffer;
+    uint32_t size;
+    uint32_t used = 0;
+    uint32_t dropped = 0;
+    uint32_t last_us = 0; //timestamp of the previous record
+    LTC2946_Transfer *xfer_pending = NULL; //background read not yet recorded
+
+    void Record(uint8_t op, uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len, int8_t status);
+    void RecordPending(); //! <Record the background read if the bus has completed it>
+};
+
+class LTC2946_Replay : public LTC2946_Bus {
+public:
+    LTC2946_Replay(const uint8_t *trace, //! <Captured trace, header included>
+                   uint32_t size          //! <Size of the trace in bytes>
+                  );
+
+    bool Valid(); //! <True if the trace header is recognized>
+    bool Done(); //! <True once every record has been served>
+    void Rewind(); //! <Serve the trace again from the start. Time keeps increasing>
+    uint32_t Served(); //! <Records served since construction>
+    uint32_t Divergences(); //! <Transactions that did not match the next record>
+
+    //! Describe the next record without serving it. Returns false at the end of the trace.
+    bool Peek(uint8_t *op, uint8_t *address, uint8_t *adc_command, uint8_t *len);
+    void Skip(); //! <Step over the next record, e.g. traffic of another device, advancing time>
+
+    void Begin();
+    int8_t Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len);
+    int8_t Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len);
+    int8_t Receive(uint8_t address, uint8_t *data, uint8_t len);
+    bool StartRead(LTC2946_Transfer *xfer);
+    void Poll();
+    bool Busy();
+    void SetTimeout(uint32_t timeout_us);
+    void Delay(uint32_t us);
+    uint32_t SetClock(uint32_t hz);
+    bool BusStuck();
+    bool Recover();
+    uint32_t Micros();
+
+private:
+    const uint8_t *trace;
+    uint32_t size;
+    uint32_t pos;           //offset of the next record
+    uint32_t now_us = 0;    //replayed time
+    uint32_t served = 0;
+    uint32_t divergences = 0;
+    LTC2946_Transfer *xfer_active = NULL;
+
+    //! Serve the next record if it matches. Returns its status, or LTC2946_ERR_OTHER on a divergence.
+    int8_t Serve(uint8_t op, uint8_t address, uint8_t adc_command, uint8_t *data, const uint8_t *written, uint8_t len);
+    //! Locate the payload of the next record and its time delta. Returns false if the record is truncated.
+    bool Locate(uint32_t *payload, uint32_t *delta);
+};
+
+#endif  // LTC2946_BUSTRACE_H
@@ -0,0 +1,105 @@
+/*!
+LTC2946_ClockScan: find the fastest SCL rate a bus runs without errors.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "LTC2946_ClockScan.h"
+
+LTC2946_ClockScan::LTC2946_ClockScan(LTC2946_Bus &bus) : bus(bus) //!constructor
+{
+}
+
+bool LTC2946_ClockScan::Add(LTC2946 &device)
+{
+    if(device_count >= LTC2946_SCAN_MAX_DEVICES) return(false);
+
+    devices[device_count++] = &device;
+    return(true);
+}
+
+uint32_t LTC2946_ClockScan::Run(const uint32_t *rates, uint8_t count, uint16_t rounds)
+{
+    LTC2946_ErrorState saved[LTC2946_SCAN_MAX_DEVICES];
+    uint32_t common_hz;
+    uint16_t errors;
+    uint8_t r, d, failed, clean = 0;
+    float sample_rate;
+
+    memset(results, 0, sizeof(results));
+    if(count == 0) return(0);
+
+    //A quarantine from before would refuse every round: set it aside for the scan
+    for(d = 0; d < device_count; d++)
+    {
+        devices[d]->SaveErrorState(&saved[d]);
+        devices[d]->ClearQuarantine();
+    }
+
+    for(r = 0; r < count; r++)
+    {
+        bus.SetClock(rates[r]);
+
+        failed = 0;
+        for(d = 0; d < device_count; d++)
+        {
+            errors = Measure(devices[d], rounds, &sample_rate);
+            if(errors == 0)
+            {
+                //Rates ascend, so a clean rate after a failing one does not count as sustained
+                if(results[d].failed_hz == 0)
+                {
+                    results[d].best_hz = rates[r];
+                    results[d].sample_rate = sample_rate;
+                }
+                continue;
+            }
+
+            failed++;
+            if(results[d].failed_hz == 0)
+            {
+                results[d].failed_hz = rates[r];
+                results[d].errors = errors;
+            }
+        }
+
+        if(failed == 0 && clean == r) clean = r + 1;
+        if(failed == device_count) break;
+    }
+
+    //clean counts the leading rates without errors on any device
+    common_hz = (clean > 0) ? rates[clean - 1] : rates[0];
+    bus.SetClock(common_hz);
+
+    //Failures provoked by the scan should not show up in ErrorCheck() or in the quarantine; what was there before stays
+    for(d = 0; d < device_count; d++) devices[d]->RestoreErrorState(&saved[d]);
+
+    return(common_hz);
+}
+
+void LTC2946_ClockScan::Result(uint8_t index, LTC2946_ClockResult *result)
+{
+    if(index < device_count) *result = results[index];
+}
+
+uint16_t LTC2946_ClockScan::Measure(LTC2946 *device, uint16_t rounds, float *sample_rate)
+{
+    LTC2946_Measurement data;
+    uint32_t start, elapsed = 0;
+    uint16_t i, errors = 0;
+    bool failed;
+
+    for(i = 0; i < rounds; i++)
+    {
+        start = bus.Micros();
+        device->ReadAll(&data);
+        elapsed += bus.Micros() - start;
+        failed = device->LastStatus() != LTC2946_OK;
+
+        if(!device->VerifyConfig()) failed = true;
+        if(failed) errors++;
+    }
+
+    *sample_rate = (elapsed > 0) ? (float)rounds * 1000000 / elapsed : 0;
+    return(errors);
+}
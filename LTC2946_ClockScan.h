@@ -0,0 +1,67 @@
+/*!
+LTC2946_ClockScan: find the fastest SCL rate a bus runs without errors.
+
+Run() steps the bus through a list of rates, lowest first. At each rate
+every device gets a number of rounds, each round one burst read of the
+measurement block, timed, and one read of the whole register map checked
+against the configuration shadow (VerifyConfig()). A round counts as an
+error if either transaction fails or the configuration comes back
+different. The scan stops after the first rate at which every device
+fails.
+
+Per device the result is the highest rate with no errors and the sample
+rate sustained there (measurement block reads per second, one device
+alone on the bus). The bus is left at the highest rate that was clean
+for every device.
+
+The configuration shadows must match the devices before the scan, i.e.
+after RestoreConfig() or ResyncConfig(). Each device's ErrorCheck() flags
+and quarantine state are saved before the scan and put back afterwards
+(LTC2946::SaveErrorState()), so failures the scan provokes leave no trace
+there while earlier faults are kept; the error counters (GetErrorStats())
+count everything. A device quarantined before the scan is still scanned.
+*/
+
+#ifndef LTC2946_CLOCKSCAN_H
+#define LTC2946_CLOCKSCAN_H
+
+#include "LTC2946.h"
+
+#define LTC2946_SCAN_MAX_DEVICES    9   //!< One per valid strap address
+
+//! Scan result of one device
+struct LTC2946_ClockResult {
+    uint32_t best_hz;           //!< Highest rate without errors, 0 if none was clean
+    float sample_rate;          //!< Measurement block reads per second at best_hz
+    uint32_t failed_hz;         //!< Lowest rate with errors, 0 if none failed
+    uint16_t errors;            //!< Rounds with errors at failed_hz
+};
+
+class LTC2946_ClockScan {
+public:
+    LTC2946_ClockScan(LTC2946_Bus &bus //! <Bus to characterize>
+                     );
+
+    bool Add(LTC2946 &device); //! <Include a device on the bus. Returns false if the scan is full>
+
+    //! Step through rates (ascending) with rounds reads per device at each.
+    //! @return The rate the bus is left at: the highest clean for every device, or rates[0] if none was.
+    //! 0 if count is 0, the bus clock is then left alone.
+    uint32_t Run(const uint32_t *rates, //!< SCL rates to try, ascending, e.g. 100000, 400000, 1000000
+                 uint8_t count,         //!< Number of rates
+                 uint16_t rounds        //!< Rounds per device and rate
+                );
+
+    void Result(uint8_t index, LTC2946_ClockResult *result); //! <Result of the index-th device added>
+
+private:
+    LTC2946_Bus &bus;
+    LTC2946 *devices[LTC2946_SCAN_MAX_DEVICES];
+    LTC2946_ClockResult results[LTC2946_SCAN_MAX_DEVICES];
+    uint8_t device_count = 0;
+
+    //! Rounds of one device at the current rate. Returns the rounds with errors.
+    uint16_t Measure(LTC2946 *device, uint16_t rounds, float *sample_rate);
+};
+
+#endif  // LTC2946_CLOCKSCAN_H
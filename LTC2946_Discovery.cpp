@@ -0,0 +1,205 @@
+/*!
+LTC2946_Discovery: find every LTC2946 on every bus and hand out ready instances.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <new>
+#include "LTC2946_Discovery.h"
+
+#if defined(ARDUINO)
+#include "LTC2946_Wire.h"
+#endif
+
+// AD0/AD1 strap addresses, 0xCE-0xDE in 8-bit form
+const uint8_t LTC2946_Discovery::strap_address[LTC2946_STRAP_ADDRESSES] = {0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F};
+
+LTC2946_Discovery::LTC2946_Discovery() //!constructor
+{
+}
+
+LTC2946_Discovery::~LTC2946_Discovery()
+{
+    Clear();
+}
+
+int8_t LTC2946_Discovery::AddBus(LTC2946_Bus &bus)
+{
+    if(bus_count >= LTC2946_DISCOVERY_MAX_BUSES) return(-1);
+
+    memset(&scans[bus_count], 0, sizeof(BusScan));
+    scans[bus_count].bus = &bus;
+    return(bus_count++);
+}
+
+#if defined(ARDUINO)
+void LTC2946_Discovery::AddWires(uint8_t count)
+{
+    uint8_t n;
+
+    for(n = 0; n < count; n++) AddBus(LTC2946_Wire::Get(n));
+}
+#endif
+
+uint8_t LTC2946_Discovery::Run(bool accept_configured)
+{
+    BusScan *scan;
+    uint8_t b, i, result, active;
+    bool probing[LTC2946_DISCOVERY_MAX_BUSES];
+
+    Clear();
+
+    //One probe in flight per bus
+    for(b = 0; b < bus_count; b++)
+    {
+        scan = &scans[b];
+        scan->bus->Begin();
+        scan->bus->SetTimeout(LTC2946_PROBE_TIMEOUT_US);
+        scan->next = 0;
+        memset(scan->result, LTC2946_PROBE_ABSENT, sizeof(scan->result));
+        scan->start_us = scan->bus->Micros();
+        scan->elapsed_us = 0;
+        probing[b] = Start(*scan);
+    }
+
+    do
+    {
+        active = 0;
+        for(b = 0; b < bus_count; b++)
+        {
+            if(!probing[b]) continue;
+
+            scan = &scans[b];
+            scan->bus->Poll();
+            if(scan->xfer.done)
+            {
+                scan->result[scan->next - 1] = Classify(&scan->xfer);
+                probing[b] = Start(*scan);
+                if(!probing[b]) scan->elapsed_us = scan->bus->Micros() - scan->start_us;
+            }
+            active += probing[b];
+        }
+    }
+    while(active > 0);
+
+    for(b = 0; b < bus_count; b++)
+    {
+        scan = &scans[b];
+        scan->bus->SetTimeout(0);
+
+        for(i = 0; i < LTC2946_STRAP_ADDRESSES; i++)
+        {
+            result = scan->result[i];
+            if(result != LTC2946_PROBE_FOUND && !(accept_configured && result == LTC2946_PROBE_MISMATCH)) continue;
+
+            new(storage[found_count]) LTC2946(*scan->bus, strap_address[i]);
+
+            //A configured device is handed out with its live configuration in the shadow
+            if(result == LTC2946_PROBE_MISMATCH)
+            {
+                Device(found_count).ResyncConfig();
+                if(Device(found_count).LastStatus() != LTC2946_OK)
+                {
+                    Device(found_count).~LTC2946();
+                    scan->result[i] = LTC2946_PROBE_FAILED;
+                    continue;
+                }
+            }
+
+            found_bus[found_count] = b;
+            found_address[found_count] = strap_address[i];
+            found_count++;
+        }
+    }
+    return(found_count);
+}
+
+uint8_t LTC2946_Discovery::Count()
+{
+    return(found_count);
+}
+
+LTC2946 &LTC2946_Discovery::Device(uint8_t index)
+{
+    return(*reinterpret_cast<LTC2946 *>(storage[index]));
+}
+
+uint8_t LTC2946_Discovery::BusIndex(uint8_t index)
+{
+    return(found_bus[index]);
+}
+
+uint8_t LTC2946_Discovery::Address(uint8_t index)
+{
+    return(found_address[index]);
+}
+
+uint8_t LTC2946_Discovery::Probe(uint8_t bus, uint8_t address)
+{
+    uint8_t i;
+
+    if(bus >= bus_count) return(LTC2946_PROBE_ABSENT);
+
+    for(i = 0; i < LTC2946_STRAP_ADDRESSES; i++)
+    {
+        if(strap_address[i] == address) return(scans[bus].result[i]);
+    }
+    return(LTC2946_PROBE_ABSENT);
+}
+
+uint32_t LTC2946_Discovery::ElapsedUs()
+{
+    uint32_t elapsed_us = 0;
+    uint8_t b;
+
+    for(b = 0; b < bus_count; b++)
+    {
+        if(scans[b].elapsed_us > elapsed_us) elapsed_us = scans[b].elapsed_us;
+    }
+    return(elapsed_us);
+}
+
+void LTC2946_Discovery::Clear()
+{
+    uint8_t i;
+
+    for(i = 0; i < found_count; i++) Device(i).~LTC2946();
+    found_count = 0;
+}
+
+// An address whose probe cannot be started, because another read holds the bus, is booked as failed
+bool LTC2946_Discovery::Start(BusScan &scan)
+{
+    while(scan.next < LTC2946_STRAP_ADDRESSES)
+    {
+        scan.xfer.address = strap_address[scan.next];
+        scan.xfer.adc_command = LTC2946_CTRLA_REG;
+        scan.xfer.data = scan.data;
+        scan.xfer.len = LTC2946_PROBE_LEN;
+
+        if(scan.bus->StartRead(&scan.xfer))
+        {
+            scan.next++;
+            return(true);
+        }
+        scan.result[scan.next++] = LTC2946_PROBE_FAILED;
+    }
+    return(false);
+}
+
+uint8_t LTC2946_Discovery::Classify(const LTC2946_Transfer *xfer)
+{
+    uint8_t image[LTC2946_REG_COUNT];
+
+    if(xfer->ack == LTC2946_ERR_ADDR_NACK) return(LTC2946_PROBE_ABSENT);
+    if(xfer->ack != LTC2946_OK) return(LTC2946_PROBE_FAILED);
+
+    //Only registers that hold still after power-on: CTRLA-ALERT1 and the power thresholds
+    LTC2946::PowerOnImage(image);
+    if(memcmp(xfer->data, image, LTC2946_ALERT1_REG + 1) != 0 ||
+       memcmp(&xfer->data[LTC2946_MAX_POWER_THRESHOLD_MSB2_REG], &image[LTC2946_MAX_POWER_THRESHOLD_MSB2_REG], 6) != 0)
+    {
+        return(LTC2946_PROBE_MISMATCH);
+    }
+    return(LTC2946_PROBE_FOUND);
+}
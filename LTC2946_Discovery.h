@@ -0,0 +1,100 @@
+/*!
+LTC2946_Discovery: find every LTC2946 on every bus and hand out ready instances.
+
+Run() probes the nine strap addresses (7-bit 0x67-0x6F, see the AD0/AD1
+table in LTC2946.h) on every added bus. A probe is one background read of
+CTRLA-ALERT1 through the power thresholds (0x00-0x13); an absent address
+costs only its NACKed address byte. The buses run in parallel: each keeps
+its own probe in flight and Run() polls them round robin, so the scan
+takes as long as the slowest bus: at most nine 20-byte reads, about 20 ms
+at 100 kHz or 5 ms at 400 kHz for a fully populated bus. Each probe runs
+under LTC2946_PROBE_TIMEOUT_US: the bus's Poll() ends a probe held past it
+with LTC2946_ERR_TIMEOUT, which is booked as LTC2946_PROBE_FAILED, so a
+stuck or stretched bus adds at most nine timeouts to the scan.
+
+Identity is confirmed from the reset values of the configuration
+registers in the probe (CTRLA, CTRLB, ALERT1 and the power thresholds,
+see LTC2946::PowerOnImage()); status and measurement registers are not
+compared. A device that acknowledges with other values is either another
+part at that address or an LTC2946 configured since power-on, e.g. across
+a microcontroller reset. It is reported as LTC2946_PROBE_MISMATCH and only
+instantiated if Run() is told to accept configured devices. Run() then
+loads its configuration shadow from the device (LTC2946::ResyncConfig()),
+and books it as LTC2946_PROBE_FAILED if that read fails.
+
+Instances live inside the LTC2946_Discovery object and stay valid until
+the next Run() or its destruction.
+*/
+
+#ifndef LTC2946_DISCOVERY_H
+#define LTC2946_DISCOVERY_H
+
+#include "LTC2946.h"
+
+#define LTC2946_STRAP_ADDRESSES         9                                                   //!< Valid AD0/AD1 strap combinations
+#define LTC2946_DISCOVERY_MAX_BUSES     4                                                   //!< Wire, Wire1, Wire2, Wire3
+#define LTC2946_DISCOVERY_MAX_DEVICES   (LTC2946_DISCOVERY_MAX_BUSES * LTC2946_STRAP_ADDRESSES)
+#define LTC2946_PROBE_TIMEOUT_US        5000    //!< Deadline of each background probe, so a dead bus cannot stall the scan
+
+// Probe results
+#define LTC2946_PROBE_ABSENT            0       //!< Address not acknowledged
+#define LTC2946_PROBE_FOUND             1       //!< Configuration registers hold their reset values
+#define LTC2946_PROBE_MISMATCH          2       //!< Acknowledged, but the configuration differs from reset
+#define LTC2946_PROBE_FAILED            3       //!< Acknowledged, then failed on the bus
+
+#define LTC2946_PROBE_LEN               (LTC2946_MIN_POWER_THRESHOLD_LSB_REG + 1)   //!< CTRLA through the power thresholds
+
+class LTC2946_Discovery {
+public:
+    LTC2946_Discovery();
+    ~LTC2946_Discovery();
+
+    //! Add a bus to scan.
+    //! @return The bus index, or -1 if LTC2946_DISCOVERY_MAX_BUSES are already added.
+    int8_t AddBus(LTC2946_Bus &bus);
+#if defined(ARDUINO)
+    void AddWires(uint8_t count = LTC2946_DISCOVERY_MAX_BUSES); //! <Add Wire through Wire<count-1>
+#endif
+
+    //! Probe every strap address on every bus and instantiate the devices found.
+    //! @return The number of devices instantiated.
+    uint8_t Run(bool accept_configured = false //!< Also instantiate devices reported as LTC2946_PROBE_MISMATCH, with their shadow read back
+               );
+
+    uint8_t Count(); //! <Devices instantiated by the last Run()>
+    LTC2946 &Device(uint8_t index); //! <Ready instance, index below Count(). Ordered by bus, then address>
+    uint8_t BusIndex(uint8_t index); //! <Bus the device sits on, as returned by AddBus()>
+    uint8_t Address(uint8_t index); //! <7-bit address of the device>
+
+    uint8_t Probe(uint8_t bus, uint8_t address); //! <LTC2946_PROBE_* result of the last Run() for a bus and 7-bit address>
+    uint32_t ElapsedUs(); //! <Duration of the last Run(), longest over the buses>
+
+    static const uint8_t strap_address[LTC2946_STRAP_ADDRESSES]; //!< 7-bit strap addresses, ascending
+
+private:
+    //! Probe state of one bus
+    struct BusScan {
+        LTC2946_Bus *bus;
+        uint8_t next;               //strap index of the next probe
+        LTC2946_Transfer xfer;
+        uint8_t data[LTC2946_PROBE_LEN];
+        uint8_t result[LTC2946_STRAP_ADDRESSES];
+        uint32_t start_us;
+        uint32_t elapsed_us;
+    };
+
+    BusScan scans[LTC2946_DISCOVERY_MAX_BUSES];
+    uint8_t bus_count = 0;
+
+    //Instances are built in place, so no heap is needed
+    alignas(LTC2946) uint8_t storage[LTC2946_DISCOVERY_MAX_DEVICES][sizeof(LTC2946)];
+    uint8_t found_bus[LTC2946_DISCOVERY_MAX_DEVICES];
+    uint8_t found_address[LTC2946_DISCOVERY_MAX_DEVICES];
+    uint8_t found_count = 0;
+
+    void Clear(); //! <Destroy the instances of the last Run()>
+    bool Start(BusScan &scan); //! <Start the next probe on a bus. Returns false when every address is done>
+    static uint8_t Classify(const LTC2946_Transfer *xfer); //! <LTC2946_PROBE_* result of a finished probe>
+};
+
+#endif  // LTC2946_DISCOVERY_H
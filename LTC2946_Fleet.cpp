@@ -0,0 +1,98 @@
+/*!
+LTC2946_Fleet: configure and trigger every LTC2946 on a bus at once.
+*/
+
+#include <stdint.h>
+#include "LTC2946_Fleet.h"
+
+LTC2946_Fleet::LTC2946_Fleet(LTC2946_Bus &bus) : bus(bus) //!constructor
+{
+}
+
+bool LTC2946_Fleet::Add(LTC2946 &device)
+{
+    if(device_count >= LTC2946_FLEET_MAX_DEVICES) return(false);
+
+    devices[device_count++] = &device;
+    return(true);
+}
+
+int8_t LTC2946_Fleet::Configure(uint8_t ctrla, uint8_t ctrlb, uint8_t alert1, uint8_t alert2, uint8_t gpio_cfg)
+{
+    int8_t ack;
+    uint8_t ctrl[3];
+    uint8_t gpio[2];
+
+    ctrl[0] = ctrla;
+    ctrl[1] = ctrlb;
+    ctrl[2] = alert1;
+    ack = Broadcast(LTC2946_CTRLA_REG, ctrl, 3);
+    if(ack != 0) return(ack);
+
+    gpio[0] = alert2;
+    gpio[1] = gpio_cfg;
+    return(Broadcast(LTC2946_ALERT2_REG, gpio, 2));
+}
+
+int8_t LTC2946_Fleet::SetThresholds(const LTC2946_Thresholds *thresholds)
+{
+    int8_t ack;
+    uint8_t data[6];
+
+    //MAX/MIN_POWER_THRESHOLD, 24 bits each
+    data[0] = thresholds->max_power >> 16;
+    data[1] = thresholds->max_power >> 8;
+    data[2] = thresholds->max_power;
+    data[3] = thresholds->min_power >> 16;
+    data[4] = thresholds->min_power >> 8;
+    data[5] = thresholds->min_power;
+    ack = Broadcast(LTC2946_MAX_POWER_THRESHOLD_MSB2_REG, data, 6);
+    if(ack != 0) return(ack);
+
+    //12-bit thresholds are left justified in their register pair
+    #define PUT_12(offset, code) data[offset] = (code) >> 4; data[offset + 1] = (code) << 4
+
+    PUT_12(0, thresholds->max_delta_sense);
+    PUT_12(2, thresholds->min_delta_sense);
+    ack = Broadcast(LTC2946_MAX_DELTA_SENSE_THRESHOLD_MSB_REG, data, 4);
+    if(ack != 0) return(ack);
+
+    PUT_12(0, thresholds->max_vin);
+    PUT_12(2, thresholds->min_vin);
+    ack = Broadcast(LTC2946_MAX_VIN_THRESHOLD_MSB_REG, data, 4);
+    if(ack != 0) return(ack);
+
+    PUT_12(0, thresholds->max_adin);
+    PUT_12(2, thresholds->min_adin);
+    ack = Broadcast(LTC2946_MAX_ADIN_THRESHOLD_MSB_REG, data, 4);
+
+    #undef PUT_12
+
+    return(ack);
+}
+
+int8_t LTC2946_Fleet::Trigger(uint8_t channel)
+{
+    uint8_t ctrla = LTC2946_CHANNEL_CONFIG_SNAPSHOT | channel;
+
+    return(Broadcast(LTC2946_CTRLA_REG, &ctrla, 1));
+}
+
+bool LTC2946_Fleet::Busy(uint8_t address)
+{
+    uint8_t status2;
+
+    if(bus.Read(address, LTC2946_STATUS2_REG, &status2, 1) != 0) return(true);
+    return((status2 & LTC2946_STATUS2_ADC_BUSY) != 0);
+}
+
+int8_t LTC2946_Fleet::Broadcast(uint8_t adc_command, const uint8_t *data, uint8_t len)
+{
+    int8_t ack = bus.Write(LTC2946_I2C_MASS_WRITE_7BIT, adc_command, data, len);
+    uint8_t i;
+
+    if(ack != 0) return(ack);
+
+    for(i = 0; i < device_count; i++) devices[i]->MirrorConfig(adc_command, data, len);
+    return(ack);
+}
@@ -0,0 +1,69 @@
+/*!
+LTC2946_Fleet: configure and trigger every LTC2946 on a bus at once.
+
+All LTC2946 acknowledge writes to the mass-write address
+(LTC2946_I2C_MASS_WRITE), so one transaction reaches every device on the bus
+regardless of its strap address. Configuration registers are grouped into
+contiguous ranges, each written with one auto-incrementing broadcast:
+CTRLA/CTRLB/ALERT1 (0x00-0x02), ALERT2/GPIO_CFG (0x32-0x33) and the four
+threshold blocks. Trigger() starts a snapshot conversion on every device
+in the same transaction, so all rails are sampled at the same instant.
+
+The mass-write address is write only. Read results back per device, e.g.
+with ReadAll() once Busy() reports the conversion finished.
+
+A broadcast bypasses the configuration shadow of every LTC2946 instance.
+Add() the instances on the bus and each successful broadcast is mirrored
+into their shadows (LTC2946::MirrorConfig()), so UpdateConfig(), Commit()
+and VerifyConfig() keep working from what the devices now hold. A failed
+broadcast may have reached some devices and not others: call
+ResyncConfig() on the instances before relying on their shadows, as for
+any instance not added.
+*/
+
+#ifndef LTC2946_FLEET_H
+#define LTC2946_FLEET_H
+
+#include "LTC2946.h"
+
+#define LTC2946_FLEET_MAX_DEVICES   9   //!< One per valid strap address
+
+class LTC2946_Fleet {
+public:
+    LTC2946_Fleet(LTC2946_Bus &bus //! <Bus whose devices are addressed together>
+                 );
+
+    //! Mirror every successful broadcast into the shadow of an instance on this bus.
+    //! @return false if LTC2946_FLEET_MAX_DEVICES are already added.
+    bool Add(LTC2946 &device);
+
+    //! Write the control, alert enable and GPIO configuration of every device.
+    //! @return LTC2946_OK, otherwise the LTC2946_ERR_* status of the first failing broadcast.
+    int8_t Configure(uint8_t ctrla,     //!< CTRLA value
+                     uint8_t ctrlb,     //!< CTRLB value
+                     uint8_t alert1,    //!< ALERT1 value
+                     uint8_t alert2,    //!< ALERT2 value
+                     uint8_t gpio_cfg   //!< GPIO_CFG value
+                    );
+
+    //! Write every alert threshold of every device.
+    //! @return LTC2946_OK, otherwise the LTC2946_ERR_* status of the first failing broadcast.
+    int8_t SetThresholds(const LTC2946_Thresholds *thresholds);
+
+    //! Start a snapshot conversion of one channel on every device in a single transaction.
+    //! @return LTC2946_OK, otherwise the LTC2946_ERR_* status.
+    int8_t Trigger(uint8_t channel //!< LTC2946_DELTA_SENSE, LTC2946_VDD, LTC2946_ADIN or LTC2946_SENSE_PLUS
+                  );
+
+    //! True while the device at address is still converting. A failed STATUS2 read counts as busy.
+    bool Busy(uint8_t address);
+
+private:
+    LTC2946_Bus &bus;
+    LTC2946 *devices[LTC2946_FLEET_MAX_DEVICES];
+    uint8_t device_count = 0;
+
+    int8_t Broadcast(uint8_t adc_command, const uint8_t *data, uint8_t len); //! <Mass write, mirrored into the shadows if it succeeds>
+};
+
+#endif  // LTC2946_FLEET_H
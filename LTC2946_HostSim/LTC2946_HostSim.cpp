@@ -0,0 +1,712 @@
+/*!
+LTC2946_HostSim: host-side simulation of multi-bus acquisition.
+
+Runs LTC2946_Acquisition against simulated buses that share one clock and
+prints the aggregate sample rate for one to four buses, each carrying nine
+LTC2946 asked for more samples than a single bus can deliver.
+
+It then runs checks of paths that need a whole bus to exercise, prints one
+line per check and exits with status 1 if any failed:
+    faults      injected NACKs and timeouts against the retry, timeout and
+                quarantine policy, on blocking and background reads
+    stuck       a device holding SDA low, freed by master-side recovery
+                and by the device's own stuck-bus timer
+    clock scan  LTC2946_ClockScan on wiring that corrupts reads above
+                400 kHz
+    shadow      configuration shadow after snapshots and failed writes
+    alert       more devices on the ALERT line than one Service() handles
+    snapshot    snapshot VIN channel and the power skew after a failed trigger
+    aligned     LTC2946_Aligned against the simulated conversion count: every
+                channel configuration, naive polling and the Micros() wrap
+    discovery   LTC2946_Discovery over three buses: found, configured,
+                absent and timed-out addresses, and the parallel scan time
+    linux       LTC2946_Linux on a stand-in for the i2c-dev ioctl, serving
+                the simulated devices: batched reads, the per-read fallback
+                of a failed batch, and the cached adapter timeout
+
+Build on Linux from the library directory:
+    cmake -S . -B build && cmake --build build && build/LTC2946_HostSim
+*/
+
+#include <stdio.h>
+#include "LTC2946_Sim.h"
+#include "LTC2946_Acquisition.h"
+#include "LTC2946_Alert.h"
+#include "LTC2946_Aligned.h"
+#include "LTC2946_ClockScan.h"
+#include "LTC2946_Discovery.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "LTC2946_Linux.h"
+#endif
+
+#define SIM_DEVICES_PER_BUS     9
+#define SIM_RATE_HZ             1000    //Per device, well beyond what one bus can carry
+#define SIM_DURATION_US         1000000
+
+static const uint8_t strap_address[SIM_DEVICES_PER_BUS] = {0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F};
+
+static float Run(uint8_t buses)
+{
+    LTC2946_SimClock clock;
+    LTC2946_SimBus *bus[LTC2946_MAX_BUSES];
+    LTC2946_SimDevice *device[LTC2946_MAX_BUSES][SIM_DEVICES_PER_BUS];
+    LTC2946 *monitor[LTC2946_MAX_BUSES][SIM_DEVICES_PER_BUS];
+    LTC2946_BusManager *manager[LTC2946_MAX_BUSES];
+    LTC2946_Acquisition acquisition;
+    float rate;
+    uint8_t b, d;
+
+    for(b = 0; b < buses; b++)
+    {
+        bus[b] = new LTC2946_SimBus(&clock);
+        manager[b] = new LTC2946_BusManager(*bus[b]);
+        for(d = 0; d < SIM_DEVICES_PER_BUS; d++)
+        {
+            device[b][d] = new LTC2946_SimDevice(strap_address[d]);
+            bus[b]->Attach(*device[b][d]);
+            monitor[b][d] = new LTC2946(*bus[b], strap_address[d]);
+            manager[b]->Add(*monitor[b][d], SIM_RATE_HZ);
+        }
+        acquisition.AddBus(*manager[b]);
+    }
+
+    while(clock.now_us < SIM_DURATION_US) acquisition.Service();
+    rate = acquisition.Rate();
+
+    for(b = 0; b < buses; b++)
+    {
+        for(d = 0; d < SIM_DEVICES_PER_BUS; d++)
+        {
+            delete monitor[b][d];
+            delete device[b][d];
+        }
+        delete manager[b];
+        delete bus[b];
+    }
+    return(rate);
+}
+
+//! Print one check. Returns 1 if it failed, for the failure count
+static uint8_t Check(const char *name, bool ok)
+{
+    printf("%-60s %s\n", name, ok ? "ok" : "FAILED");
+    return(ok ? 0 : 1);
+}
+
+static uint8_t CheckFaults()
+{
+    LTC2946_SimBus bus;
+    LTC2946_SimDevice sim_a(strap_address[0]), sim_b(strap_address[1]);
+    LTC2946 a(bus, strap_address[0]), b(bus, strap_address[1]);
+    LTC2946_BusManager manager(bus);
+    LTC2946_Measurement data;
+    LTC2946_ErrorStats stats;
+    LTC2946_DeviceStats stats_a, stats_b;
+    LTC2946_Transfer xfer;
+    uint8_t block[LTC2946_MEAS_BLOCK_LEN];
+    uint32_t start, elapsed, transactions;
+    LTC2946_BusCost cost;
+    uint8_t failed = 0;
+
+    bus.Attach(sim_a);
+    bus.Attach(sim_b);
+    a.SetTimeout(2000);
+    a.SetRetryPolicy(2, 100);
+    b.SetTimeout(2000);
+
+    //Two NACKs, then the second retry gets through
+    sim_a.inject_status = LTC2946_ERR_DATA_NACK;
+    sim_a.inject_count = 2;
+    a.ReadAll(&data);
+    a.GetErrorStats(&stats);
+    failed += Check("faults: retries ride out two NACKs", a.LastStatus() == LTC2946_OK && stats.retries == 2);
+
+    //Every attempt times out: the call fails within WorstCaseUs()
+    sim_a.inject_status = LTC2946_ERR_TIMEOUT;
+    sim_a.inject_count = 3;
+    start = bus.Micros();
+    a.ReadAll(&data);
+    elapsed = bus.Micros() - start;
+    failed += Check("faults: timed-out attempts end within WorstCaseUs()", a.LastStatus() == LTC2946_ERR_TIMEOUT && elapsed <= a.WorstCaseUs());
+
+    //Extreme policies saturate instead of wrapping
+    a.SetRetryPolicy(255, 0xFFFFFFFF);
+    failed += Check("faults: WorstCaseUs() saturates", a.WorstCaseUs() == 0xFFFFFFFF);
+    a.SetRetryPolicy(2, 100);
+
+    //A blocking read behind a background read that stalls
+    sim_a.inject_count = 1;
+    a.StartReadBlock(LTC2946_MEAS_BLOCK_START, block, LTC2946_MEAS_BLOCK_LEN, &xfer);
+    start = bus.Micros();
+    a.ReadAll(&data);
+    elapsed = bus.Micros() - start;
+    failed += Check("faults: stalled background read ends with a timeout", xfer.done && xfer.ack == LTC2946_ERR_TIMEOUT);
+    failed += Check("faults: blocking read behind it within WorstCaseUs()", a.LastStatus() == LTC2946_OK && elapsed <= a.WorstCaseUs());
+    a.FinishBlock(&xfer);
+
+    //Two failed transactions quarantine the device: it is refused without bus traffic until the period ends
+    a.SetRetryPolicy(0, 0);
+    a.SetQuarantine(2, 50000);
+    sim_a.inject_status = LTC2946_ERR_ADDR_NACK;
+    sim_a.inject_count = 2;
+    a.ReadAll(&data);
+    a.ReadAll(&data);
+    bus.GetCost(&cost);
+    transactions = cost.transactions;
+    a.ReadAll(&data);
+    bus.GetCost(&cost);
+    failed += Check("faults: quarantined device is skipped off the bus",
+                    a.Quarantined() && a.LastStatus() == LTC2946_ERR_QUARANTINED && cost.transactions == transactions);
+    bus.Advance(50000);
+    a.ReadAll(&data);
+    failed += Check("faults: probe after the quarantine period gets through", !a.Quarantined() && a.LastStatus() == LTC2946_OK);
+
+    //A device whose background reads keep timing out does not hold up its neighbour
+    a.SetQuarantine(0, 0);
+    manager.Add(a, 100);
+    manager.Add(b, 100);
+    sim_a.inject_status = LTC2946_ERR_TIMEOUT;
+    sim_a.inject_count = 20;
+    start = bus.Micros();
+    while(bus.Micros() - start < 1000000)
+    {
+        manager.Service();
+        bus.Advance(10);
+    }
+    manager.Stats(0, &stats_a);
+    manager.Stats(1, &stats_b);
+    failed += Check("faults: background timeouts do not stall the manager",
+                    stats_a.errors == 20 && stats_a.samples + stats_a.errors >= 99 && stats_b.samples >= 99 && stats_b.errors == 0);
+
+    return(failed);
+}
+
+static uint8_t CheckStuckBus()
+{
+    LTC2946_SimBus bus;
+    LTC2946_SimDevice sim(strap_address[0]);
+    LTC2946 device(bus, strap_address[0]);
+    LTC2946_Measurement data;
+    LTC2946_ErrorStats stats;
+    uint32_t start;
+    uint8_t failed = 0;
+
+    bus.Attach(sim);
+    device.SetTimeout(2000);
+    device.SetRetryPolicy(1, 0);
+
+    //Master-side recovery clocks the device free, the retry then succeeds
+    bus.HoldSDA(sim, 5);
+    device.ReadAll(&data);
+    device.GetErrorStats(&stats);
+    failed += Check("stuck: recovery frees SDA and the retry succeeds",
+                    device.LastStatus() == LTC2946_OK && stats.recoveries == 1 && stats.recover_failures == 0 && !bus.BusStuck());
+    failed += Check("stuck: time-to-recover within LTC2946_RECOVER_MAX_US", stats.last_recover_us <= LTC2946_RECOVER_MAX_US);
+
+    //Without it, the device's own stuck-bus timer releases SDA
+    device.SetBusRecovery(false);
+    device.EnableStuckBusTimer(false);
+    bus.HoldSDA(sim, 9);
+    start = bus.Micros();
+    while(bus.BusStuck() && bus.Micros() - start < 2 * LTC2946_SIM_STUCK_BUS_US) bus.Advance(100);
+    failed += Check("stuck: device stuck-bus timer releases SDA", !bus.BusStuck() && bus.Micros() - start >= LTC2946_SIM_STUCK_BUS_US);
+    device.ReadAll(&data);
+    failed += Check("stuck: bus usable after the timer", device.LastStatus() == LTC2946_OK);
+
+    return(failed);
+}
+
+static uint8_t CheckClockScan()
+{
+    static const uint32_t rates[] = {100000, 400000, 1000000};
+    LTC2946_SimBus bus;
+    LTC2946_SimDevice *sim[SIM_DEVICES_PER_BUS];
+    LTC2946 *device[SIM_DEVICES_PER_BUS];
+    LTC2946_ClockScan scan(bus);
+    LTC2946_ClockResult result;
+    LTC2946_Measurement data;
+    uint32_t hz;
+    uint8_t d, failed = 0;
+    bool as_expected = true, released = true, kept;
+
+    //Marginal wiring: reads above 400 kHz come back with a damaged bit
+    bus.SetStableClock(400000);
+    for(d = 0; d < 3; d++)
+    {
+        sim[d] = new LTC2946_SimDevice(strap_address[d]);
+        bus.Attach(*sim[d]);
+        device[d] = new LTC2946(bus, strap_address[d]);
+        device[d]->SetQuarantine(2, 1000000);
+        scan.Add(*device[d]);
+    }
+
+    failed += Check("clock scan: empty rate list leaves the bus alone", scan.Run(rates, 0, 5) == 0);
+
+    //The last device had a real fault before the scan and is quarantined for it
+    sim[2]->inject_status = LTC2946_ERR_ADDR_NACK;
+    sim[2]->inject_count = 2;
+    device[2]->ReadAll(&data);
+    device[2]->ReadAll(&data);
+
+    hz = scan.Run(rates, 3, 5);
+    for(d = 0; d < 3; d++)
+    {
+        scan.Result(d, &result);
+        if(result.best_hz != 400000 || result.failed_hz != 1000000 || result.errors == 0) as_expected = false;
+    }
+    kept = device[2]->Quarantined() && !device[2]->ErrorCheck();
+    for(d = 0; d < 2; d++)
+    {
+        if(device[d]->Quarantined() || !device[d]->ErrorCheck()) released = false;
+    }
+    failed += Check("clock scan: 400 kHz clean, 1 MHz fails on every device", hz == 400000 && as_expected);
+    failed += Check("clock scan: no quarantine or ErrorCheck() failure left", released);
+    failed += Check("clock scan: fault and quarantine from before kept", kept);
+
+    for(d = 0; d < 3; d++)
+    {
+        delete device[d];
+        delete sim[d];
+    }
+    return(failed);
+}
+
+static uint8_t CheckShadow()
+{
+    LTC2946_SimBus bus;
+    LTC2946_SimDevice sim(strap_address[0]);
+    LTC2946 device(bus, strap_address[0]);
+    uint8_t ctrla = LTC2946_CHANNEL_CONFIG_A_V_C_2 | LTC2946_SENSE_PLUS;
+    uint8_t failed = 0;
+
+    bus.Attach(sim);
+    device.WriteConfig(LTC2946_CTRLA_REG, ctrla);
+
+    //A snapshot trigger is not configuration: RestoreConfig() writes the user's CTRLA back
+    device.SetSnapShot();
+    device.ReadVIN();
+    failed += Check("shadow: snapshot trigger kept out of the shadow",
+                    device.ReadConfig(LTC2946_CTRLA_REG) == ctrla && device.VerifyConfig());
+    device.RestoreConfig();
+    failed += Check("shadow: RestoreConfig() after a snapshot restores CTRLA", sim.regs[LTC2946_CTRLA_REG] == ctrla);
+
+    //A write the device never took leaves the shadow alone and a staged register dirty
+    sim.inject_status = LTC2946_ERR_ADDR_NACK;
+    sim.inject_count = 1;
+    device.WriteConfig(LTC2946_CTRLB_REG, LTC2946_ENABLE_ALERT_CLEAR);
+    failed += Check("shadow: failed write not shadowed", device.ReadConfig(LTC2946_CTRLB_REG) == sim.regs[LTC2946_CTRLB_REG]);
+    sim.inject_count = 1;
+    device.StageConfig(LTC2946_ALERT1_REG, 0x80);
+    device.Commit();
+    device.Commit();
+    failed += Check("shadow: failed Commit() retried by the next one",
+                    sim.regs[LTC2946_ALERT1_REG] == 0x80 && device.ReadConfig(LTC2946_ALERT1_REG) == 0x80);
+    device.ErrorCheck();
+    return(failed);
+}
+
+static uint8_t CheckAlert()
+{
+    LTC2946_SimBus bus;
+    LTC2946_SimDevice *sim[LTC2946_ALERT_MAX_DEVICES + 3];
+    LTC2946_Alert alert(bus);
+    uint8_t first, second, third, d, failed = 0;
+
+    //Every device asserts ALERT before the first Service()
+    for(d = 0; d < LTC2946_ALERT_MAX_DEVICES + 3; d++)
+    {
+        sim[d] = new LTC2946_SimDevice(0x50 + d);
+        sim[d]->regs[LTC2946_FAULT1_REG] = 0x80;
+        sim[d]->alert = true;
+        bus.Attach(*sim[d]);
+    }
+    alert.Signal();
+
+    first = alert.Service();
+    second = alert.Service();
+    third = alert.Service();
+    failed += Check("alert: devices past the limit serviced on the next call",
+                    first == LTC2946_ALERT_MAX_DEVICES && second == 3 && third == 0 && !bus.Alert());
+
+    for(d = 0; d < LTC2946_ALERT_MAX_DEVICES + 3; d++) delete sim[d];
+    return(failed);
+}
+
+static uint8_t CheckSnapshot()
+{
+    LTC2946_SimBus bus;
+    LTC2946_SimDevice sim(strap_address[0]);
+    LTC2946 device(bus, strap_address[0]);
+    LTC2946_Measurement data;
+    LTC2946_SnapshotStats stats;
+    uint8_t failed = 0;
+    float vin;
+
+    bus.Attach(sim);
+    sim.sense_plus_code = 0x800;
+    sim.vdd_code = 0x400;
+    sim.delta_sense_code = 0x100;
+    device.SetSnapShot();
+
+    vin = device.ReadVIN();
+    device.ReadSnapshotAll(&data);
+    device.GetSnapshotStats(&stats);
+    failed += Check("snapshot: ReadVIN() and ReadSnapshotAll() convert SENSE+",
+                    vin == data.vin && data.vin_code == 0x800);
+    failed += Check("snapshot: power skew of about 10 ms", stats.last_power_skew_us > 9000 && stats.last_power_skew_us < 11000);
+
+    //VDD on request, for code that relied on the earlier snapshot ReadVIN()
+    device.SetSnapshotVIN(LTC2946_VDD);
+    device.ReadSnapshotAll(&data);
+    failed += Check("snapshot: SetSnapshotVIN(LTC2946_VDD) converts VDD",
+                    data.vin_code == 0x400 && !device.SetSnapshotVIN(LTC2946_ADIN));
+    device.SetSnapshotVIN(LTC2946_SENSE_PLUS);
+
+    //The VIN trigger fails: no skew is reported for the pair
+    sim.inject_status = LTC2946_ERR_ADDR_NACK;
+    sim.inject_count = 1;
+    device.ReadSnapshotAll(&data);
+    device.GetSnapshotStats(&stats);
+    failed += Check("snapshot: no power skew after a failed trigger", stats.last_power_skew_us == 0);
+
+    //No interrupt slot for a pin off target: refused before the device is touched
+    failed += Check("snapshot: refused alert pin leaves ALERT2 alone",
+                    !device.EnableSnapshotAlert(2) && !(sim.regs[LTC2946_ALERT2_REG] & LTC2946_ENABLE_ADC_DONE_ALERT));
+    return(failed);
+}
+
+//! Follow one channel with LTC2946_Aligned for duration_us, or poll every poll_us and book the reads with Account().
+//! Returns true if the read counters match the conversions the simulated device completed.
+static bool RunAligned(LTC2946_SimClock &clock, uint8_t ctrla, uint8_t channel, uint32_t poll_us, uint32_t duration_us, LTC2946_AlignStats *stats)
+{
+    LTC2946_SimBus bus(&clock);
+    LTC2946_SimDevice sim(strap_address[0]);
+    LTC2946 device(bus, strap_address[0]);
+    LTC2946_Aligned aligned(device, bus);
+    LTC2946_Measurement data;
+    uint8_t index = (channel == LTC2946_DELTA_SENSE) ? 0 : 1;
+    uint32_t start, base, seen, fresh, wait, reads = 0, duplicates = 0, missed = 0;
+
+    bus.Attach(sim);
+    aligned.Begin(ctrla, channel);
+    base = sim.conversions[index];
+    seen = base;
+    start = bus.Micros();
+
+    while(bus.Micros() - start < duration_us)
+    {
+        if(poll_us == 0)
+        {
+            wait = aligned.UntilDueUs();
+            if(wait != 0)
+            {
+                bus.Advance(wait < duration_us ? wait : duration_us);
+                continue;
+            }
+            aligned.Service(&data);
+        }
+        else
+        {
+            aligned.Account();
+            device.ReadAll(&data);
+            bus.Advance(poll_us - (bus.Micros() - start) % poll_us);
+        }
+
+        //Ground truth: what the device converted since the last read
+        fresh = sim.conversions[index] - seen;
+        seen = sim.conversions[index];
+        reads++;
+        if(fresh == 0) duplicates++;
+        else missed += fresh - 1;
+    }
+
+    aligned.GetStats(stats);
+    return(stats->reads == reads && stats->duplicates == duplicates && stats->missed == missed &&
+           stats->conversions == seen - base);
+}
+
+static uint8_t CheckAligned()
+{
+    static const uint8_t config[] = {LTC2946_CHANNEL_CONFIG_V_C_3, LTC2946_CHANNEL_CONFIG_V_C_2, LTC2946_CHANNEL_CONFIG_V_C_1,
+                                     LTC2946_CHANNEL_CONFIG_A_V_C_3, LTC2946_CHANNEL_CONFIG_A_V_C_2, LTC2946_CHANNEL_CONFIG_A_V_C_1,
+                                     LTC2946_CHANNEL_CONFIG_V_C};
+    static const uint8_t channel[] = {LTC2946_DELTA_SENSE, LTC2946_SENSE_PLUS};
+    LTC2946_SimClock clock;
+    LTC2946_SimBus bus(&clock);
+    LTC2946_SimDevice sim(strap_address[0]);
+    LTC2946 device(bus, strap_address[0]);
+    LTC2946_Aligned aligned(device, bus);
+    LTC2946_AlignStats stats;
+    uint32_t start;
+    uint8_t c, ch, failed = 0;
+    bool exact = true, every = true, frame;
+
+    //Every configuration and channel: each conversion read exactly once
+    for(c = 0; c < sizeof(config); c++)
+    {
+        for(ch = 0; ch < sizeof(channel); ch++)
+        {
+            if(!RunAligned(clock, config[c] | LTC2946_SENSE_PLUS, channel[ch], 0, 20000000, &stats)) exact = false;
+            if(stats.duplicates != 0 || stats.missed != 0) every = false;
+        }
+    }
+    failed += Check("aligned: model matches the device in all 7 configurations", exact);
+    failed += Check("aligned: every conversion read once, no duplicates", every);
+
+    //Frame timings worked out by hand from the datasheet sequence, not from the conversion table:
+    //V_C_2 is VIN + 15 delta sense = 2200 + 15 * 16404 = 248260 us, A_V_C_1 is VIN + ADIN + 254 delta sense = 4171016 us
+    failed += Check("aligned: PeriodUs() matches hand-derived frames",
+                    LTC2946_Aligned::PeriodUs(LTC2946_CHANNEL_CONFIG_V_C_2, LTC2946_SENSE_PLUS) == 248260 &&
+                    LTC2946_Aligned::PeriodUs(LTC2946_CHANNEL_CONFIG_V_C_2, LTC2946_DELTA_SENSE) == 248260 / 15 &&
+                    LTC2946_Aligned::PeriodUs(LTC2946_CHANNEL_CONFIG_A_V_C_1, LTC2946_DELTA_SENSE) == 4171016 / 254 &&
+                    LTC2946_Aligned::PeriodUs(LTC2946_CHANNEL_CONFIG_V_C, LTC2946_DELTA_SENSE) == 16404 &&
+                    LTC2946_Aligned::PeriodUs(LTC2946_CHANNEL_CONFIG_V_C, LTC2946_SENSE_PLUS) == 0);
+
+    //A_V_C_2 on the device: VIN and ADIN done by 4400 us, the 30th delta sense at 496520 us, the next VIN at 498720 us
+    bus.Attach(sim);
+    start = bus.Micros();
+    device.WriteConfig(LTC2946_CTRLA_REG, LTC2946_CHANNEL_CONFIG_A_V_C_2 | LTC2946_SENSE_PLUS);
+    bus.Advance(495520 - (bus.Micros() - start));
+    device.ReadVIN();
+    frame = (sim.conversions[0] == 29 && sim.conversions[1] == 1 && sim.conversions[2] == 1);
+    bus.Advance(497520 - (bus.Micros() - start));
+    device.ReadVIN();
+    frame = frame && sim.conversions[0] == 30 && sim.conversions[1] == 1;
+    bus.Advance(499720 - (bus.Micros() - start));
+    device.ReadVIN();
+    failed += Check("aligned: device frame matches hand-derived timings", frame && sim.conversions[1] == 2 && sim.conversions[2] == 1);
+
+    //A plain poll loop booked with Account(): too fast duplicates, too slow misses
+    exact = RunAligned(clock, LTC2946_CHANNEL_CONFIG_V_C_3 | LTC2946_SENSE_PLUS, LTC2946_DELTA_SENSE, 5000, 10000000, &stats);
+    failed += Check("aligned: 5 ms polling counted as duplicates", exact && stats.duplicates > stats.reads / 2 && stats.missed == 0);
+    exact = RunAligned(clock, LTC2946_CHANNEL_CONFIG_V_C_3 | LTC2946_SENSE_PLUS, LTC2946_DELTA_SENSE, 40000, 10000000, &stats);
+    failed += Check("aligned: 40 ms polling counted as missed", exact && stats.missed > stats.reads);
+
+    //Across the Micros() wrap
+    clock.now_us = 0xFFFFFFFF - 3000000;
+    exact = RunAligned(clock, LTC2946_CHANNEL_CONFIG_A_V_C_3 | LTC2946_SENSE_PLUS, LTC2946_DELTA_SENSE, 0, 6000000, &stats);
+    failed += Check("aligned: Micros() wrap", exact && stats.conversions > 250 && stats.duplicates == 0 && stats.missed == 0);
+
+    //A failed CTRLA write schedules nothing
+    sim.inject_status = LTC2946_ERR_ADDR_NACK;
+    sim.inject_count = 1;
+    failed += Check("aligned: failed Begin() schedules no reads",
+                    !aligned.Begin(LTC2946_CHANNEL_CONFIG_V_C_3, LTC2946_DELTA_SENSE) && aligned.UntilDueUs() == 0xFFFFFFFF);
+
+    return(failed);
+}
+
+static uint8_t CheckDiscovery()
+{
+    LTC2946_SimClock clock;
+    LTC2946_SimBus *bus[3];
+    LTC2946_SimDevice *sim[SIM_DEVICES_PER_BUS + 4];
+    LTC2946_SimDevice *configured, *stalled;
+    LTC2946_Discovery *alone;
+    LTC2946_Discovery discovery;
+    uint32_t slowest_us = 0, sum_us = 0, start;
+    uint8_t b, d, i, count, failed = 0;
+    bool verified = false;
+
+    //Wire: a full bus. Wire1: 0x67 at reset and 0x6A configured. Wire2: 0x6F, and 0x6B which stalls its probe
+    for(b = 0; b < 3; b++) bus[b] = new LTC2946_SimBus(&clock);
+    for(d = 0; d < SIM_DEVICES_PER_BUS; d++)
+    {
+        sim[d] = new LTC2946_SimDevice(strap_address[d]);
+        bus[0]->Attach(*sim[d]);
+    }
+    sim[d] = new LTC2946_SimDevice(0x67);
+    bus[1]->Attach(*sim[d++]);
+    configured = sim[d] = new LTC2946_SimDevice(0x6A);
+    configured->regs[LTC2946_CTRLA_REG] = LTC2946_CHANNEL_CONFIG_A_V_C_3 | LTC2946_SENSE_PLUS;
+    configured->regs[LTC2946_ALERT1_REG] = 0x80;
+    bus[1]->Attach(*sim[d++]);
+    stalled = sim[d] = new LTC2946_SimDevice(0x6B);
+    bus[2]->Attach(*sim[d++]);
+    sim[d] = new LTC2946_SimDevice(0x6F);
+    bus[2]->Attach(*sim[d]);
+
+    //Each bus on its own, for the serial scan time
+    for(b = 0; b < 3; b++)
+    {
+        stalled->inject_status = LTC2946_ERR_TIMEOUT;
+        stalled->inject_count = 1;
+        alone = new LTC2946_Discovery();
+        alone->AddBus(*bus[b]);
+        alone->Run();
+        sum_us += alone->ElapsedUs();
+        if(alone->ElapsedUs() > slowest_us) slowest_us = alone->ElapsedUs();
+        delete alone;
+    }
+
+    for(b = 0; b < 3; b++) discovery.AddBus(*bus[b]);
+    stalled->inject_count = 1;
+    start = clock.now_us;
+    count = discovery.Run();
+    failed += Check("discovery: reset devices found, others left out", count == SIM_DEVICES_PER_BUS + 2);
+    failed += Check("discovery: FOUND, MISMATCH, ABSENT and FAILED per address",
+                    discovery.Probe(0, 0x6C) == LTC2946_PROBE_FOUND && discovery.Probe(1, 0x67) == LTC2946_PROBE_FOUND &&
+                    discovery.Probe(1, 0x6A) == LTC2946_PROBE_MISMATCH && discovery.Probe(1, 0x68) == LTC2946_PROBE_ABSENT &&
+                    discovery.Probe(2, 0x6B) == LTC2946_PROBE_FAILED && discovery.Probe(2, 0x6F) == LTC2946_PROBE_FOUND);
+    failed += Check("discovery: buses in parallel, slowest one sets the time",
+                    discovery.ElapsedUs() <= slowest_us + 100 && clock.now_us - start <= slowest_us + 100 && slowest_us < sum_us);
+
+    stalled->inject_count = 1;
+    count = discovery.Run(true);
+    for(i = 0; i < count; i++)
+    {
+        if(discovery.BusIndex(i) == 1 && discovery.Address(i) == 0x6A) verified = discovery.Device(i).VerifyConfig();
+    }
+    failed += Check("discovery: configured device accepted with its live shadow", count == SIM_DEVICES_PER_BUS + 3 && verified);
+
+    for(d = 0; d < SIM_DEVICES_PER_BUS + 4; d++) delete sim[d];
+    for(b = 0; b < 3; b++) delete bus[b];
+    return(failed);
+}
+
+#if defined(__linux__)
+static LTC2946_SimBus *adapter_bus;     //devices behind the stand-in i2c-dev adapter
+static uint32_t adapter_timeouts = 0;   //I2C_TIMEOUT requests it received
+static unsigned long adapter_timeout;   //and the last value, in 10 ms units
+
+// Stand-in for ioctl(2) on /dev/i2c-N. I2C_RDWR messages are served from the simulated devices: a command
+// byte write followed by a read of the same address is a register read. Like an adapter driver, it aborts
+// the whole transfer at the first NACK.
+static int AdapterIoctl(int /*fd*/, unsigned long request, void *arg)
+{
+    struct i2c_rdwr_ioctl_data *rdwr = (struct i2c_rdwr_ioctl_data *)arg;
+    struct i2c_msg *msg;
+    int8_t status;
+    uint32_t i;
+
+    if(request == I2C_TIMEOUT)
+    {
+        adapter_timeouts++;
+        adapter_timeout = (unsigned long)arg;
+        return(0);
+    }
+    if(request != I2C_RDWR)
+    {
+        errno = EINVAL;
+        return(-1);
+    }
+
+    for(i = 0; i < rdwr->nmsgs; i++)
+    {
+        msg = &rdwr->msgs[i];
+        if(msg->flags & I2C_M_RD)
+        {
+            status = adapter_bus->Receive(msg->addr, msg->buf, msg->len);
+        }
+        else if(i + 1 < rdwr->nmsgs && (msg[1].flags & I2C_M_RD) && msg[1].addr == msg->addr)
+        {
+            status = adapter_bus->Read(msg->addr, msg->buf[0], msg[1].buf, msg[1].len);
+            i++;
+        }
+        else
+        {
+            status = adapter_bus->Write(msg->addr, msg->buf[0], &msg->buf[1], msg->len - 1);
+        }
+
+        if(status != LTC2946_OK)
+        {
+            errno = ENXIO;
+            return(-1);
+        }
+    }
+    return(rdwr->nmsgs);
+}
+
+static uint8_t CheckLinux()
+{
+    LTC2946_SimBus sim_bus;
+    LTC2946_SimDevice *device[SIM_DEVICES_PER_BUS];
+    LTC2946_Transfer xfers[SIM_DEVICES_PER_BUS + 1];
+    uint8_t blocks[SIM_DEVICES_PER_BUS + 1][LTC2946_MEAS_BLOCK_LEN];
+    LTC2946_Measurement data;
+    uint32_t calls, timeouts;
+    uint8_t d, ok, failed = 0;
+    bool decoded = true;
+
+    adapter_bus = &sim_bus;
+    LTC2946_Linux bus(0, AdapterIoctl);
+
+    for(d = 0; d <= SIM_DEVICES_PER_BUS; d++)
+    {
+        if(d < SIM_DEVICES_PER_BUS)
+        {
+            device[d] = new LTC2946_SimDevice(strap_address[d]);
+            sim_bus.Attach(*device[d]);
+        }
+        //The last transfer goes to the mass-write address, which nobody answers for reads
+        xfers[d].address = (d < SIM_DEVICES_PER_BUS) ? strap_address[d] : LTC2946_I2C_MASS_WRITE_7BIT;
+        xfers[d].adc_command = LTC2946_MEAS_BLOCK_START;
+        xfers[d].data = blocks[d];
+        xfers[d].len = LTC2946_MEAS_BLOCK_LEN;
+    }
+
+    calls = bus.Ioctls();
+    ok = bus.ReadBatch(xfers, SIM_DEVICES_PER_BUS);
+    failed += Check("linux: 9 block reads in one ioctl", ok == SIM_DEVICES_PER_BUS && bus.Ioctls() - calls == 1);
+
+    calls = bus.Ioctls();
+    ok = bus.ReadBatch(xfers, SIM_DEVICES_PER_BUS + 1);
+    failed += Check("linux: failed batch repeats each read with its own status",
+                    ok == SIM_DEVICES_PER_BUS && xfers[SIM_DEVICES_PER_BUS].ack == LTC2946_ERR_ADDR_NACK &&
+                    bus.Ioctls() - calls == 1 + SIM_DEVICES_PER_BUS + 1);
+
+    LTC2946 monitor(bus, strap_address[0]);
+    device[0]->sense_plus_code = 0x5A5;
+    monitor.SetTimeout(20000);
+    calls = bus.Ioctls();
+    timeouts = adapter_timeouts;
+    for(d = 0; d < 100; d++)
+    {
+        monitor.ReadAll(&data);
+        if(monitor.LastStatus() != LTC2946_OK) decoded = false;
+    }
+    failed += Check("linux: adapter timeout set once over 100 reads", adapter_timeouts - timeouts == 1 && bus.Ioctls() - calls == 101);
+    failed += Check("linux: reads decode the simulated VIN", decoded && data.vin_code == 0x5A5);
+
+    monitor.SetTimeout(0);
+    monitor.ReadAll(&data);
+    failed += Check("linux: timeout 0 restores the adapter default", adapter_timeout == LTC2946_LINUX_DEFAULT_TIMEOUT);
+
+    for(d = 0; d < SIM_DEVICES_PER_BUS; d++) delete device[d];
+    return(failed);
+}
+#endif
+
+int main()
+{
+    float single = 0, rate;
+    uint8_t buses;
+    uint8_t failed = 0;
+
+    printf("buses | samples/s | scaling\n");
+    for(buses = 1; buses <= LTC2946_MAX_BUSES; buses++)
+    {
+        rate = Run(buses);
+        if(buses == 1) single = rate;
+        printf("%5u | %9.1f | %6.2fx\n", buses, rate, rate / single);
+    }
+
+    printf("\n");
+    failed += CheckFaults();
+    failed += CheckStuckBus();
+    failed += CheckClockScan();
+    failed += CheckShadow();
+    failed += CheckAlert();
+    failed += CheckSnapshot();
+    failed += CheckAligned();
+    failed += CheckDiscovery();
+#if defined(__linux__)
+    failed += CheckLinux();
+#endif
+
+    return(failed != 0);
+}
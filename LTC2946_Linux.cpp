@@ -0,0 +1,235 @@
+/*!
+LTC2946_Linux: LTC2946_Bus implementation on top of Linux i2c-dev.
+*/
+
+#include "LTC2946_Linux.h"
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+static int LTC2946_linux_ioctl(int fd, unsigned long request, void *arg)
+{
+    return(ioctl(fd, request, arg));
+}
+
+LTC2946_Linux::LTC2946_Linux(const char *device) : device(device), own_fd(true), io(LTC2946_linux_ioctl) //!constructor
+{
+}
+
+LTC2946_Linux::LTC2946_Linux(int fd, LTC2946_IoctlFn io) : device(NULL), fd(fd), own_fd(false), io(io != NULL ? io : LTC2946_linux_ioctl) //!constructor
+{
+}
+
+LTC2946_Linux::~LTC2946_Linux()
+{
+    if(own_fd && fd >= 0) close(fd);
+}
+
+void LTC2946_Linux::Begin()
+{
+    if(fd < 0 && device != NULL) fd = open(device, O_RDWR);
+}
+
+bool LTC2946_Linux::IsOpen()
+{
+    return(fd >= 0);
+}
+
+// Write len bytes starting at register adc_command: one message, command byte first
+int8_t LTC2946_Linux::Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len)
+// Returns LTC2946_OK or LTC2946_ERR_*
+{
+    uint8_t buf[1 + 255];
+    struct i2c_msg msg;
+
+    Poll();
+
+    buf[0] = adc_command;
+    memcpy(&buf[1], data, len);
+
+    msg.addr = address;
+    msg.flags = 0;
+    msg.len = 1 + len;
+    msg.buf = buf;
+    return(Transfer(&msg, 1));
+}
+
+// Command byte write and data read combined with a repeated START
+int8_t LTC2946_Linux::Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len)
+// Returns LTC2946_OK or LTC2946_ERR_*
+{
+    struct i2c_msg msgs[2];
+
+    Poll();
+
+    msgs[0].addr = address;
+    msgs[0].flags = 0;
+    msgs[0].len = 1;
+    msgs[0].buf = &adc_command;
+    msgs[1].addr = address;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = len;
+    msgs[1].buf = data;
+    return(Transfer(msgs, 2));
+}
+
+// Plain read without a register pointer write
+int8_t LTC2946_Linux::Receive(uint8_t address, uint8_t *data, uint8_t len)
+// Returns LTC2946_OK or LTC2946_ERR_*
+{
+    struct i2c_msg msg;
+
+    Poll();
+
+    msg.addr = address;
+    msg.flags = I2C_M_RD;
+    msg.len = len;
+    msg.buf = data;
+    return(Transfer(&msg, 1));
+}
+
+uint8_t LTC2946_Linux::ReadBatch(LTC2946_Transfer *xfers, uint8_t count)
+{
+    struct i2c_msg msgs[2 * LTC2946_LINUX_MAX_BATCH];
+    uint8_t first, n, i, ok = 0;
+    int8_t status;
+
+    Poll();
+
+    for(first = 0; first < count; first += n)
+    {
+        n = (count - first < LTC2946_LINUX_MAX_BATCH) ? count - first : LTC2946_LINUX_MAX_BATCH;
+
+        for(i = 0; i < n; i++)
+        {
+            msgs[2 * i].addr = xfers[first + i].address;
+            msgs[2 * i].flags = 0;
+            msgs[2 * i].len = 1;
+            msgs[2 * i].buf = &xfers[first + i].adc_command;
+            msgs[2 * i + 1].addr = xfers[first + i].address;
+            msgs[2 * i + 1].flags = I2C_M_RD;
+            msgs[2 * i + 1].len = xfers[first + i].len;
+            msgs[2 * i + 1].buf = xfers[first + i].data;
+        }
+        status = Transfer(msgs, 2 * n);
+
+        for(i = 0; i < n; i++)
+        {
+            //A failed batch does not say which device failed: repeat each read on its own
+            xfers[first + i].ack = (status == LTC2946_OK || n == 1) ? status :
+                                   Read(xfers[first + i].address, xfers[first + i].adc_command, xfers[first + i].data, xfers[first + i].len);
+            xfers[first + i].done = true;
+            if(xfers[first + i].ack == LTC2946_OK) ok++;
+        }
+    }
+    return(ok);
+}
+
+// Queue a read for Poll(); i2c-dev has no background transfers
+bool LTC2946_Linux::StartRead(LTC2946_Transfer *xfer)
+{
+    if(xfer_queued != NULL) return(false);
+
+    xfer->done = false;
+    xfer_queued = xfer;
+    return(true);
+}
+
+void LTC2946_Linux::Poll()
+{
+    LTC2946_Transfer *xfer = xfer_queued;
+
+    if(xfer == NULL) return;
+
+    xfer_queued = NULL;
+    xfer->ack = Read(xfer->address, xfer->adc_command, xfer->data, xfer->len);
+    xfer->done = true;
+}
+
+bool LTC2946_Linux::Busy()
+{
+    return(xfer_queued != NULL);
+}
+
+uint32_t LTC2946_Linux::Micros()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return((uint32_t)((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000));
+}
+
+// i2c-dev takes the adapter timeout in units of 10 ms; round up. 0 goes back to the I2C core default,
+// which i2c-dev cannot read back, so it is written as LTC2946_LINUX_DEFAULT_TIMEOUT.
+// The LTC2946 class calls this before every transaction, so the ioctl is only made on a change.
+void LTC2946_Linux::SetTimeout(uint32_t timeout_us)
+{
+    unsigned long jiffies = (timeout_us + 9999) / 10000;
+    unsigned long value = (jiffies != 0) ? jiffies : LTC2946_LINUX_DEFAULT_TIMEOUT;
+
+    if(fd < 0 || jiffies == timeout_jiffies) return;
+
+    ioctls++;
+    if(io(fd, I2C_TIMEOUT, (void *)value) == 0) timeout_jiffies = jiffies;
+}
+
+void LTC2946_Linux::Delay(uint32_t us)
+{
+    usleep(us);
+}
+
+// The rate of an i2c-dev adapter is fixed by its device tree or module parameters
+uint32_t LTC2946_Linux::SetClock(uint32_t /*hz*/)
+{
+    return(0);
+}
+
+bool LTC2946_Linux::BusStuck()
+{
+    return(false);
+}
+
+bool LTC2946_Linux::Recover()
+{
+    return(true);
+}
+
+uint32_t LTC2946_Linux::Ioctls()
+{
+    return(ioctls);
+}
+
+int8_t LTC2946_Linux::Transfer(void *msgs, uint32_t count)
+{
+    struct i2c_rdwr_ioctl_data rdwr;
+
+    if(fd < 0) return(LTC2946_ERR_OTHER);
+
+    rdwr.msgs = (struct i2c_msg *)msgs;
+    rdwr.nmsgs = count;
+    ioctls++;
+    if(io(fd, I2C_RDWR, &rdwr) < 0) return(Status(errno));
+    return(LTC2946_OK);
+}
+
+// Adapter drivers report an address NACK as ENXIO or EREMOTEIO; a data NACK is not told apart
+int8_t LTC2946_Linux::Status(int error)
+{
+    switch(error)
+    {
+        case ENXIO:
+        case EREMOTEIO: return(LTC2946_ERR_ADDR_NACK);
+        case ETIMEDOUT: return(LTC2946_ERR_TIMEOUT);
+        default: return(LTC2946_ERR_OTHER);
+    }
+}
+
+#endif  // __linux__
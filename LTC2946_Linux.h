@@ -0,0 +1,91 @@
+/*!
+LTC2946_Linux: LTC2946_Bus implementation on top of Linux i2c-dev.
+
+Every transaction is one I2C_RDWR ioctl on /dev/i2c-N. A register read
+is a combined message pair (command byte write, repeated START, data
+read), so it costs one system call and cannot be split by another
+master. ReadBatch() packs the reads of several devices into a single
+ioctl, up to LTC2946_LINUX_MAX_BATCH per call.
+
+I2C_RDWR reports success or failure for the whole batch only. When a
+batch fails, its reads are repeated one by one so that each transfer
+carries its own status.
+
+The ioctl is reached through a function pointer. Tests can construct the
+bus on any file descriptor with a replacement that inspects the
+i2c_rdwr_ioctl_data and fills the read buffers, no adapter needed.
+
+The adapter timeout is set with an I2C_TIMEOUT ioctl only when it
+changes, so the per-transaction SetTimeout() of the LTC2946 class costs
+no system call. A timeout of 0 restores the I2C core default of one
+second (LTC2946_LINUX_DEFAULT_TIMEOUT); i2c-dev cannot disable the
+timeout or read back a driver's own default.
+
+i2c-dev transfers block the caller. StartRead() queues the read and
+Poll() performs it, which keeps LTC2946_BusManager working unchanged.
+The adapter driver handles bus recovery itself, so BusStuck() always
+reports a free bus.
+*/
+
+#ifndef LTC2946_LINUX_H
+#define LTC2946_LINUX_H
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <stdint.h>
+#include "LTC2946_Bus.h"
+
+#define LTC2946_LINUX_MAX_BATCH         21  //!< Reads per ioctl: I2C_RDWR_IOCTL_MAX_MSGS (42) message pairs
+#define LTC2946_LINUX_DEFAULT_TIMEOUT   100 //!< I2C core default adapter timeout, one second in I2C_TIMEOUT units of 10 ms
+
+//! ioctl(2) replacement, called with I2C_RDWR or I2C_TIMEOUT. Returns -1 and sets errno on failure.
+typedef int (*LTC2946_IoctlFn)(int fd, unsigned long request, void *arg);
+
+class LTC2946_Linux : public LTC2946_Bus {
+public:
+    LTC2946_Linux(const char *device //! <Adapter device node, e.g. "/dev/i2c-1", opened by Begin()>
+                 );
+    LTC2946_Linux(int fd,                   //! <Descriptor that is already open, not closed by this object>
+                  LTC2946_IoctlFn io = NULL //! <ioctl replacement, NULL for ioctl(2)>
+                 );
+    ~LTC2946_Linux();
+
+    void Begin();
+    bool IsOpen(); //! <True once the adapter is open>
+    int8_t Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len);
+    int8_t Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len);
+    int8_t Receive(uint8_t address, uint8_t *data, uint8_t len);
+
+    //! Read several register blocks, usually one per device, in as few ioctls as possible.
+    //! Every transfer gets its ack and done flag. Returns the number of transfers that succeeded.
+    uint8_t ReadBatch(LTC2946_Transfer *xfers, uint8_t count);
+
+    bool StartRead(LTC2946_Transfer *xfer);
+    void Poll();
+    bool Busy();
+    uint32_t Micros();
+    void SetTimeout(uint32_t timeout_us);
+    void Delay(uint32_t us);
+    uint32_t SetClock(uint32_t hz);
+    bool BusStuck();
+    bool Recover();
+
+    uint32_t Ioctls(); //! <I2C_RDWR and I2C_TIMEOUT system calls made so far>
+
+private:
+    const char *device; //device node, NULL when constructed on a descriptor
+    int fd = -1;
+    bool own_fd;        //descriptor opened by Begin() and closed by the destructor
+    LTC2946_IoctlFn io;
+    LTC2946_Transfer *xfer_queued = NULL;
+    uint32_t ioctls = 0;
+    unsigned long timeout_jiffies = 0; //adapter timeout last set, 0 while it holds the adapter default
+
+    //! One I2C_RDWR call with count messages. Returns LTC2946_OK or LTC2946_ERR_*
+    int8_t Transfer(void *msgs, uint32_t count);
+    static int8_t Status(int error); //! <Map errno to LTC2946_ERR_*>
+};
+
+#endif  // __linux__
+
+#endif  // LTC2946_LINUX_H
@@ -0,0 +1,583 @@
+/*!
+LTC2946_Sim: host-side stand-in for LTC2946 devices and the bus they sit on.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "LTC2946_Sim.h"
+
+LTC2946_SimDevice::LTC2946_SimDevice(uint8_t address) : address(address) //!constructor
+{
+    Reset();
+}
+
+void LTC2946_SimDevice::Reset()
+{
+    LTC2946::PowerOnImage(regs);
+    started = false;
+    charge_frac = 0;
+    energy_frac = 0;
+}
+
+void LTC2946_SimDevice::Run(uint32_t now_us)
+{
+    bool shutdown = regs[LTC2946_CTRLB_REG] & LTC2946_ENABLE_SHUTDOWN;
+    bool accumulate = (regs[LTC2946_CTRLB_REG] & ~LTC2946_CTRLB_ACC_MASK) != LTC2946_DISABLE_ACC &&
+                      !(regs[LTC2946_CTRLB_REG] & LTC2946_RESET_ACC);
+    bool conversion_due, tick_due;
+
+    //The first access after power-on starts the time base
+    if(!started)
+    {
+        started = true;
+        tick_us = now_us + LTC2946_CURRENT_CONV_US;
+        Start(now_us);
+        return;
+    }
+
+    //Shutdown stops the ADC and the time base, both pick up where they were on wake
+    if(shutdown)
+    {
+        done_us = now_us + (converting == CONV_CURRENT ? LTC2946_CURRENT_CONV_US : LTC2946_VOLTAGE_CONV_US);
+        tick_us = now_us + LTC2946_CURRENT_CONV_US;
+        return;
+    }
+
+    //Replay conversions and ticks in time order
+    while(true)
+    {
+        conversion_due = converting != CONV_NONE && (int32_t)(now_us - done_us) >= 0;
+        tick_due = (int32_t)(now_us - tick_us) >= 0;
+        if(!conversion_due && !tick_due) break;
+
+        if(conversion_due && (!tick_due || (int32_t)(done_us - tick_us) <= 0))
+        {
+            Complete(converting);
+            if((regs[LTC2946_CTRLA_REG] & ~LTC2946_CTRLA_CHANNEL_CONFIG_MASK) == LTC2946_CHANNEL_CONFIG_SNAPSHOT)
+            {
+                converting = CONV_NONE;
+                regs[LTC2946_STATUS2_REG] &= ~LTC2946_STATUS2_ADC_BUSY;
+                continue;
+            }
+
+            slot++;
+            if(SlotConversion(slot) == CONV_NONE)
+            {
+                slot = 0;
+                first_frame = false;
+            }
+            converting = SlotConversion(slot);
+            done_us += (converting == CONV_CURRENT) ? LTC2946_CURRENT_CONV_US : LTC2946_VOLTAGE_CONV_US;
+        }
+        else
+        {
+            if(accumulate) Tick();
+            tick_us += LTC2946_CURRENT_CONV_US;
+        }
+    }
+}
+
+void LTC2946_SimDevice::Control(uint8_t adc_command, uint8_t len, uint32_t now_us)
+{
+    uint8_t power_on[LTC2946_REG_COUNT];
+    uint8_t i;
+
+    if(len == 0) return;
+
+    //Accumulator reset is a level: the accumulators stay clear while the CTRLB reset bits are set
+    if(adc_command <= LTC2946_CTRLB_REG && adc_command + len > LTC2946_CTRLB_REG &&
+       (regs[LTC2946_CTRLB_REG] & LTC2946_RESET_ACC))
+    {
+        Put(LTC2946_TIME_COUNTER_MSB3_REG, 4, 0);
+        Put(LTC2946_CHARGE_MSB3_REG, 4, 0);
+        Put(LTC2946_ENERGY_MSB3_REG, 4, 0);
+        charge_frac = 0;
+        energy_frac = 0;
+
+        //Reset all also clears the measurements and their min/max
+        if((regs[LTC2946_CTRLB_REG] & ~LTC2946_CTRLB_RESET_MASK) == LTC2946_RESET_ALL)
+        {
+            LTC2946::PowerOnImage(power_on);
+            for(i = LTC2946_POWER_MSB2_REG; i <= LTC2946_MIN_ADIN_LSB_REG; i++)
+            {
+                if(i < LTC2946_MAX_POWER_THRESHOLD_MSB2_REG || (i >= LTC2946_DELTA_SENSE_MSB_REG && (i - LTC2946_DELTA_SENSE_MSB_REG) % 10 < 6))
+                    regs[i] = power_on[i];
+            }
+        }
+    }
+
+    if(adc_command == LTC2946_CTRLA_REG) Start(now_us);
+
+    //Clearing the fault registers releases ALERT
+    if((adc_command <= LTC2946_FAULT1_REG && adc_command + len > LTC2946_FAULT1_REG) ||
+       (adc_command <= LTC2946_FAULT2_REG && adc_command + len > LTC2946_FAULT2_REG))
+    {
+        if(regs[LTC2946_FAULT1_REG] == 0 && regs[LTC2946_FAULT2_REG] == 0) alert = false;
+    }
+}
+
+void LTC2946_SimDevice::Start(uint32_t now_us)
+{
+    uint8_t voltage_sel = regs[LTC2946_CTRLA_REG] & ~LTC2946_CTRLA_VOLTAGE_SEL_MASK;
+
+    first_frame = true;
+    slot = 0;
+
+    if((regs[LTC2946_CTRLA_REG] & ~LTC2946_CTRLA_CHANNEL_CONFIG_MASK) == LTC2946_CHANNEL_CONFIG_SNAPSHOT)
+    {
+        //Snapshot: one conversion of the channel selected by CTRLA[4:3]
+        converting = (voltage_sel == LTC2946_DELTA_SENSE) ? CONV_CURRENT : (voltage_sel == LTC2946_ADIN) ? CONV_ADIN : CONV_VIN;
+        regs[LTC2946_STATUS2_REG] |= LTC2946_STATUS2_ADC_BUSY;
+    }
+    else
+    {
+        converting = SlotConversion(0);
+        regs[LTC2946_STATUS2_REG] &= ~LTC2946_STATUS2_ADC_BUSY;
+    }
+    done_us = now_us + ((converting == CONV_CURRENT) ? LTC2946_CURRENT_CONV_US : LTC2946_VOLTAGE_CONV_US);
+}
+
+// Frame layout per channel configuration: VIN, then ADIN, then the delta sense conversions
+uint8_t LTC2946_SimDevice::SlotConversion(uint16_t slot)
+{
+    uint8_t config = regs[LTC2946_CTRLA_REG] & ~LTC2946_CTRLA_CHANNEL_CONFIG_MASK;
+    uint8_t vin, adin;
+
+    if(config == LTC2946_CHANNEL_CONFIG_SNAPSHOT) return(CONV_NONE);
+
+    //V_C measures VIN once after the CTRLA write, then delta sense only
+    vin = (config == LTC2946_CHANNEL_CONFIG_V_C && !first_frame) ? 0 : 1;
+    adin = (config >= LTC2946_CHANNEL_CONFIG_A_V_C_3 && config <= LTC2946_CHANNEL_CONFIG_A_V_C_1) ? 1 : 0;
+
+    if(slot < vin) return(CONV_VIN);
+    slot -= vin;
+    if(slot < adin) return(CONV_ADIN);
+    slot -= adin;
+    return(slot < LTC2946::CurrentConversions(config) ? CONV_CURRENT : CONV_NONE);
+}
+
+void LTC2946_SimDevice::Complete(uint8_t conversion)
+{
+    uint8_t voltage_sel = regs[LTC2946_CTRLA_REG] & ~LTC2946_CTRLA_VOLTAGE_SEL_MASK;
+    bool snapshot = (regs[LTC2946_CTRLA_REG] & ~LTC2946_CTRLA_CHANNEL_CONFIG_MASK) == LTC2946_CHANNEL_CONFIG_SNAPSHOT;
+
+    switch(conversion)
+    {
+        case CONV_CURRENT:
+            Store12(LTC2946_DELTA_SENSE_MSB_REG, delta_sense_code);
+            //Power is the product of the new delta sense code and the last VIN code
+            if(!snapshot) Store24(LTC2946_POWER_MSB2_REG, (uint32_t)delta_sense_code * (Get(LTC2946_VIN_MSB_REG, 2) >> 4));
+            break;
+        case CONV_VIN:
+            Store12(LTC2946_VIN_MSB_REG, voltage_sel == LTC2946_VDD ? vdd_code : voltage_sel == LTC2946_ADIN ? adin_code : sense_plus_code);
+            break;
+        case CONV_ADIN:
+            Store12(LTC2946_ADIN_MSB_REG, adin_code);
+            break;
+        default:
+            return;
+    }
+    conversions[conversion]++;
+
+    //ADC done alert: latched in FAULT2, pulls ALERT (GPIO3) low until cleared
+    if(regs[LTC2946_ALERT2_REG] & LTC2946_ENABLE_ADC_DONE_ALERT)
+    {
+        regs[LTC2946_FAULT2_REG] |= LTC2946_FAULT2_ADC_DONE;
+        alert = true;
+    }
+}
+
+// TIME_COUNTER counts ticks; CHARGE gains delta sense / 16 and ENERGY power / 65536 per tick
+void LTC2946_SimDevice::Tick()
+{
+    Put(LTC2946_TIME_COUNTER_MSB3_REG, 4, Get(LTC2946_TIME_COUNTER_MSB3_REG, 4) + 1);
+
+    charge_frac += Get(LTC2946_DELTA_SENSE_MSB_REG, 2) >> 4;
+    Put(LTC2946_CHARGE_MSB3_REG, 4, Get(LTC2946_CHARGE_MSB3_REG, 4) + (charge_frac >> 4));
+    charge_frac &= 0x0F;
+
+    energy_frac += Get(LTC2946_POWER_MSB2_REG, 3);
+    Put(LTC2946_ENERGY_MSB3_REG, 4, Get(LTC2946_ENERGY_MSB3_REG, 4) + (energy_frac >> 16));
+    energy_frac &= 0xFFFF;
+}
+
+// 12-bit results are left justified; MAX follows at +2 and MIN at +4
+void LTC2946_SimDevice::Store12(uint8_t adc_command, uint16_t code)
+{
+    code &= 0x0FFF;
+    Put(adc_command, 2, (uint32_t)code << 4);
+    if(code > (Get(adc_command + 2, 2) >> 4)) Put(adc_command + 2, 2, (uint32_t)code << 4);
+    if(code < (Get(adc_command + 4, 2) >> 4)) Put(adc_command + 4, 2, (uint32_t)code << 4);
+}
+
+// 24-bit power; MAX follows at +3 and MIN at +6
+void LTC2946_SimDevice::Store24(uint8_t adc_command, uint32_t code)
+{
+    Put(adc_command, 3, code);
+    if(code > Get(adc_command + 3, 3)) Put(adc_command + 3, 3, code);
+    if(code < Get(adc_command + 6, 3)) Put(adc_command + 6, 3, code);
+}
+
+uint32_t LTC2946_SimDevice::Get(uint8_t adc_command, uint8_t len)
+{
+    uint32_t value = 0;
+    uint8_t i;
+
+    for(i = 0; i < len; i++) value = (value << 8) | regs[adc_command + i];
+    return(value);
+}
+
+void LTC2946_SimDevice::Put(uint8_t adc_command, uint8_t len, uint32_t value)
+{
+    while(len > 0)
+    {
+        regs[adc_command + --len] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+LTC2946_SimBus::LTC2946_SimBus(LTC2946_SimClock *clock) : clock(clock != NULL ? clock : &own_clock) //!constructor
+{
+}
+
+void LTC2946_SimBus::Attach(LTC2946_SimDevice &device)
+{
+    if(device_count < LTC2946_SIM_MAX_DEVICES) devices[device_count++] = &device;
+}
+
+void LTC2946_SimBus::Begin()
+{
+}
+
+// Write len bytes starting at register adc_command, auto-incrementing. Writes past CLK_DIV are dropped.
+int8_t LTC2946_SimBus::Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len)
+// Returns LTC2946_OK or LTC2946_ERR_*
+{
+    int8_t status;
+
+    Drain();
+    if(BusStuck())
+    {
+        clock->now_us += StuckTime();
+        return(LTC2946_ERR_OTHER);
+    }
+    status = WriteRegs(address, adc_command, data, len);
+    Count(false, len);
+    clock->now_us += (status == LTC2946_ERR_TIMEOUT && timeout_us != 0) ? timeout_us : WireTime(false, len);
+    return(status);
+}
+
+// Read len bytes starting at register adc_command, auto-incrementing. Reads past CLK_DIV return 0xFF.
+int8_t LTC2946_SimBus::Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len)
+// Returns LTC2946_OK or LTC2946_ERR_*
+{
+    int8_t status;
+
+    Drain();
+    if(BusStuck())
+    {
+        clock->now_us += StuckTime();
+        return(LTC2946_ERR_OTHER);
+    }
+    status = ReadRegs(address, adc_command, data, len);
+    Count(true, len);
+    clock->now_us += (status == LTC2946_ERR_TIMEOUT && timeout_us != 0) ? timeout_us : WireTime(true, len);
+    return(status);
+}
+
+// Plain read. Only the Alert Response Address is modeled: the lowest alerting address wins arbitration,
+// answers with its 8-bit address byte and releases ALERT.
+int8_t LTC2946_SimBus::Receive(uint8_t address, uint8_t *data, uint8_t len)
+// Returns LTC2946_OK or LTC2946_ERR_*
+{
+    LTC2946_SimDevice *winner = NULL;
+    uint8_t i;
+
+    Drain();
+    if(BusStuck())
+    {
+        clock->now_us += StuckTime();
+        return(LTC2946_ERR_OTHER);
+    }
+    cost.transactions++;
+    cost.bytes += 1 + len;
+    cost.starts++;
+    cost.stops++;
+    cost.wire_us += BitTime(1 + 9 + 9 * (uint32_t)len + 1);
+    clock->now_us += BitTime(1 + 9 + 9 * (uint32_t)len + 1);
+    if(address != LTC2946_I2C_ALERT_RESPONSE_7BIT)
+    {
+        for(i = 0; i < len; i++) data[i] = 0xFF;
+        return(Find(address) == NULL ? LTC2946_ERR_ADDR_NACK : LTC2946_OK);
+    }
+
+    for(i = 0; i < device_count; i++)
+    {
+        if(devices[i]->alert && (winner == NULL || devices[i]->address < winner->address)) winner = devices[i];
+    }
+    if(winner == NULL) return(LTC2946_ERR_ADDR_NACK);
+
+    winner->alert = false;
+    for(i = 0; i < len; i++) data[i] = (winner->address << 1) | 1;
+    return(LTC2946_OK);
+}
+
+bool LTC2946_SimBus::StartRead(LTC2946_Transfer *xfer)
+{
+    LTC2946_SimDevice *device;
+
+    if(xfer_active != NULL) return(false);
+
+    xfer->done = false;
+    xfer_active = xfer;
+    if(BusStuck())
+    {
+        xfer_finish_us = clock->now_us + StuckTime();
+        return(true);
+    }
+    Count(true, xfer->len);
+    xfer_finish_us = clock->now_us + WireTime(true, xfer->len);
+
+    //A read that is going to time out ends at its deadline, as a blocking one does
+    device = Find(xfer->address);
+    if(device != NULL && device->inject_count > 0 && device->inject_status == LTC2946_ERR_TIMEOUT && timeout_us != 0)
+    {
+        xfer_finish_us = clock->now_us + timeout_us;
+    }
+    return(true);
+}
+
+void LTC2946_SimBus::Poll()
+{
+    LTC2946_Transfer *xfer = xfer_active;
+
+    clock->now_us += 1;
+    if(xfer == NULL || (int32_t)(clock->now_us - xfer_finish_us) < 0) return;
+
+    //Complete the whole block at once, as a DMA transfer would
+    xfer_active = NULL;
+    xfer->ack = BusStuck() ? LTC2946_ERR_OTHER : ReadRegs(xfer->address, xfer->adc_command, xfer->data, xfer->len);
+    xfer->done = true;
+}
+
+bool LTC2946_SimBus::Busy()
+{
+    return(xfer_active != NULL);
+}
+
+uint32_t LTC2946_SimBus::Micros()
+{
+    return(clock->now_us);
+}
+
+void LTC2946_SimBus::Advance(uint32_t us)
+{
+    clock->now_us += us;
+}
+
+void LTC2946_SimBus::SetTimeout(uint32_t timeout_us)
+{
+    this->timeout_us = timeout_us;
+}
+
+bool LTC2946_SimBus::Alert()
+{
+    bool low = false;
+    uint8_t i;
+
+    for(i = 0; i < device_count; i++)
+    {
+        devices[i]->Run(clock->now_us);
+        if(devices[i]->alert) low = true;
+    }
+    return(low);
+}
+
+void LTC2946_SimBus::Delay(uint32_t us)
+{
+    clock->now_us += us;
+}
+
+uint32_t LTC2946_SimBus::SetClock(uint32_t hz)
+{
+    clock_hz = hz;
+    return(hz);
+}
+
+void LTC2946_SimBus::SetStableClock(uint32_t hz)
+{
+    stable_hz = hz;
+}
+
+void LTC2946_SimBus::HoldSDA(LTC2946_SimDevice &device, uint8_t clocks)
+{
+    device.stuck_clocks = clocks;
+    device.stuck_since_us = clock->now_us;
+}
+
+// A device releases SDA on its own once its stuck-bus timer expires, if CTRLB enables the timer
+bool LTC2946_SimBus::BusStuck()
+{
+    bool stuck = false;
+    uint8_t i;
+
+    for(i = 0; i < device_count; i++)
+    {
+        if(devices[i]->stuck_clocks == 0) continue;
+        if((devices[i]->regs[LTC2946_CTRLB_REG] & LTC2946_ENABLE_STUCK_BUS_RECOVER) &&
+           clock->now_us - devices[i]->stuck_since_us >= LTC2946_SIM_STUCK_BUS_US) devices[i]->stuck_clocks = 0;
+        else stuck = true;
+    }
+    return(stuck);
+}
+
+// Up to nine SCL pulses, each one shifting a stuck device one bit further, then a STOP
+bool LTC2946_SimBus::Recover()
+{
+    uint8_t pulse, i;
+
+    if(xfer_active != NULL)
+    {
+        xfer_active->ack = LTC2946_ERR_OTHER;
+        xfer_active->done = true;
+        xfer_active = NULL;
+    }
+
+    for(pulse = 0; pulse < 9 && BusStuck(); pulse++)
+    {
+        clock->now_us += LTC2946_SIM_RECOVER_CLOCK_US;
+        for(i = 0; i < device_count; i++)
+        {
+            if(devices[i]->stuck_clocks > 0) devices[i]->stuck_clocks--;
+        }
+    }
+    clock->now_us += LTC2946_SIM_RECOVER_CLOCK_US;
+
+    return(!BusStuck());
+}
+
+// A master waiting for the bus to go idle gives up at its timeout; without one, count a START attempt
+uint32_t LTC2946_SimBus::StuckTime()
+{
+    return(timeout_us != 0 ? timeout_us : BitTime(1));
+}
+
+// A blocking transaction waits at most one timeout for the background read, then abandons it
+void LTC2946_SimBus::Drain()
+{
+    if(xfer_active == NULL) return;
+
+    if(timeout_us != 0 && (int32_t)(xfer_finish_us - clock->now_us) > (int32_t)timeout_us)
+    {
+        clock->now_us += timeout_us;
+        xfer_active->ack = LTC2946_ERR_TIMEOUT;
+        xfer_active->done = true;
+        xfer_active = NULL;
+        return;
+    }
+    if((int32_t)(xfer_finish_us - clock->now_us) > 0) clock->now_us = xfer_finish_us;
+    Poll();
+}
+
+// Bits on the wire: START, address+W, command, then either data (write) or repeated START, address+R, data (read), STOP.
+// Every byte costs 9 clocks including its acknowledge; START, repeated START and STOP are counted as one clock each.
+uint32_t LTC2946_SimBus::WireTime(bool read, uint8_t len)
+{
+    uint32_t bits;
+
+    bits = 1 + 9 + 9 + 9 * (uint32_t)len + 1;
+    if(read) bits += 1 + 9;
+
+    return(BitTime(bits));
+}
+
+void LTC2946_SimBus::Count(bool read, uint8_t len)
+{
+    cost.transactions++;
+    cost.bytes += 2 + len + (read ? 1 : 0);
+    cost.starts++;
+    if(read) cost.restarts++;
+    cost.stops++;
+    cost.wire_us += WireTime(read, len);
+}
+
+void LTC2946_SimBus::GetCost(LTC2946_BusCost *cost)
+{
+    *cost = this->cost;
+}
+
+void LTC2946_SimBus::ResetCost()
+{
+    memset(&cost, 0, sizeof(cost));
+}
+
+uint32_t LTC2946_SimBus::BitTime(uint32_t bits)
+{
+    return((uint32_t)(((uint64_t)bits * 1000000 + clock_hz - 1) / clock_hz));
+}
+
+int8_t LTC2946_SimBus::WriteRegs(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len)
+{
+    LTC2946_SimDevice *device = Find(address);
+    uint8_t i;
+
+    //Mass write: every device takes the data
+    if(address == LTC2946_I2C_MASS_WRITE_7BIT)
+    {
+        if(device_count == 0) return(LTC2946_ERR_ADDR_NACK);
+        for(i = 0; i < device_count; i++) WriteRegs(devices[i]->address, adc_command, data, len);
+        return(LTC2946_OK);
+    }
+
+    if(device == NULL) return(LTC2946_ERR_ADDR_NACK);
+    if(device->inject_count > 0)
+    {
+        device->inject_count--;
+        if(device->inject_status != LTC2946_ERR_SHORT_READ) return(device->inject_status);
+    }
+
+    device->Run(clock->now_us);
+    for(i = 0; i < len && adc_command + i < LTC2946_REG_COUNT; i++) device->regs[adc_command + i] = data[i];
+    device->Control(adc_command, i, clock->now_us);
+    return(LTC2946_OK);
+}
+
+int8_t LTC2946_SimBus::ReadRegs(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len)
+{
+    LTC2946_SimDevice *device = Find(address);
+    uint8_t i;
+
+    if(device == NULL) return(LTC2946_ERR_ADDR_NACK);
+    device->Run(clock->now_us);
+    if(device->inject_count > 0)
+    {
+        device->inject_count--;
+        if(device->inject_status == LTC2946_ERR_SHORT_READ) len /= 2;
+        else return(device->inject_status);
+        for(i = 0; i < len; i++) data[i] = (adc_command + i < LTC2946_REG_COUNT) ? device->regs[adc_command + i] : 0xFF;
+        return(LTC2946_ERR_SHORT_READ);
+    }
+
+    for(i = 0; i < len; i++) data[i] = (adc_command + i < LTC2946_REG_COUNT) ? device->regs[adc_command + i] : 0xFF;
+    Corrupt(data, len);
+    return(LTC2946_OK);
+}
+
+void LTC2946_SimBus::Corrupt(uint8_t *data, uint8_t len)
+{
+    if(stable_hz == 0 || clock_hz <= stable_hz || len == 0) return;
+
+    data[corrupt_count % len] ^= 1 << (corrupt_count % 8);
+    corrupt_count++;
+}
+
+LTC2946_SimDevice *LTC2946_SimBus::Find(uint8_t address)
+{
+    uint8_t i;
+
+    for(i = 0; i < device_count; i++)
+    {
+        if(devices[i]->address == address) return(devices[i]);
+    }
+    return(NULL);
+}
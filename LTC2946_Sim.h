@@ -0,0 +1,172 @@
+/*!
+LTC2946_Sim: host-side stand-in for LTC2946 devices and the bus they sit on.
+
+LTC2946_SimDevice holds the 0x00-0x43 register map of one device and
+models its ADC: continuous conversions in the order and with the timing
+of the CTRLA channel configuration, single snapshot conversions with the
+STATUS2 busy bit, min/max tracking, and the TIME_COUNTER, CHARGE and
+ENERGY accumulators ticking on the internal time base. The analog inputs
+are set as ADC codes.
+LTC2946_SimBus implements LTC2946_Bus over any number of attached devices
+with register auto-increment, so the LTC2946 class and every transfer path,
+including background block reads, can be exercised on a Linux host.
+
+Time is simulated. A blocking transaction advances the clock by the time
+its START, address, data and STOP bits take at the modeled bus clock. A
+background read runs "on the wire" without holding up the caller and
+completes on the first Poll() at or after its finish time, the way a DMA
+transfer finishes some time after it was started; each Poll() costs one
+microsecond. Advance() accounts for time spent elsewhere.
+
+Several buses can share one LTC2946_SimClock, so transfers in flight on
+different buses overlap in time as they do on separate I2C peripherals.
+*/
+
+#ifndef LTC2946_SIM_H
+#define LTC2946_SIM_H
+
+#include "LTC2946.h"
+
+#define LTC2946_SIM_MAX_DEVICES     16  //!< The nine strap addresses plus other parts answering the Alert Response Address
+#define LTC2946_SIM_CLOCK_HZ        100000  //!< Default modeled SCL rate (standard mode)
+#define LTC2946_SIM_STUCK_BUS_US    33000   //!< Modeled delay of the device's own stuck-bus timer (CTRLB stuck-bus recover)
+#define LTC2946_SIM_RECOVER_CLOCK_US 10     //!< SCL period of Recover(), fixed like the i2c_t3 resetBus() bit-bang
+
+//! Bus traffic counted by LTC2946_SimBus, the cost model of a register access
+struct LTC2946_BusCost {
+    uint32_t transactions;      //!< Transactions put on the wire
+    uint32_t bytes;             //!< Address, command and data bytes
+    uint32_t starts;            //!< START conditions
+    uint32_t restarts;          //!< Repeated START conditions
+    uint32_t stops;             //!< STOP conditions
+    uint32_t wire_us;           //!< Modeled wire time at the bus clock
+};
+
+//! Simulated time base, shared by buses that run concurrently
+struct LTC2946_SimClock {
+    uint32_t now_us = 0;
+};
+
+class LTC2946_SimDevice {
+public:
+    LTC2946_SimDevice(uint8_t address //! <I2C address the device answers on>
+                     );
+
+    void Reset(); //! <Load power-on register values and stop the ADC until the next access>
+
+    //! Run conversions and accumulator ticks up to now_us. The bus calls this before every access.
+    void Run(uint32_t now_us);
+    //! Act on a register write: a CTRLA write restarts the conversion sequence, CTRLB reset bits clear accumulators.
+    void Control(uint8_t adc_command, uint8_t len, uint32_t now_us);
+
+    uint8_t address; //I2C address of the device
+
+    //Analog inputs as 12-bit ADC codes
+    uint16_t delta_sense_code = 0;
+    uint16_t sense_plus_code = 0;
+    uint16_t vdd_code = 0;
+    uint16_t adin_code = 0;
+
+    uint32_t conversions[3] = {0, 0, 0}; //completed conversions: delta sense, VIN, ADIN
+    bool alert = false; //device is pulling ALERT low and will answer the Alert Response Address
+
+    //Fault injection: the next inject_count transactions fail with inject_status. A
+    //LTC2946_ERR_SHORT_READ read delivers only the first half of the requested bytes. An
+    //LTC2946_ERR_TIMEOUT costs the bus timeout, background reads included, when one is set.
+    int8_t inject_status = LTC2946_OK;
+    uint16_t inject_count = 0;
+
+    //Stuck bus: the device holds SDA low until it sees stuck_clocks more SCL pulses, or until its own
+    //stuck-bus timer expires if CTRLB enables it. Set through LTC2946_SimBus::HoldSDA().
+    uint8_t stuck_clocks = 0;
+    uint32_t stuck_since_us = 0;
+    uint8_t regs[LTC2946_REG_COUNT]; //register map, indexed by command byte
+
+private:
+    enum {CONV_CURRENT, CONV_VIN, CONV_ADIN, CONV_NONE};
+
+    bool started = false; //sequencer has a time reference
+    bool first_frame;     //first frame after a CTRLA write, the only one with VIN in V_C mode
+    uint16_t slot;        //position in the current frame
+    uint8_t converting;   //CONV_* in progress
+    uint32_t done_us;     //time the conversion in progress completes
+    uint32_t tick_us;     //time of the next accumulator tick
+    uint32_t charge_frac; //accumulator remainders below one register LSB
+    uint32_t energy_frac;
+
+    void Start(uint32_t now_us); //! <Begin the conversion sequence set by CTRLA>
+    uint8_t SlotConversion(uint16_t slot); //! <CONV_* for a frame slot, CONV_NONE past the end of the frame>
+    void Complete(uint8_t conversion);
+    void Tick(); //! <One accumulator tick>
+
+    //! Store a result and update its min/max registers
+    void Store12(uint8_t adc_command, uint16_t code);
+    void Store24(uint8_t adc_command, uint32_t code);
+    uint32_t Get(uint8_t adc_command, uint8_t len);
+    void Put(uint8_t adc_command, uint8_t len, uint32_t value);
+};
+
+class LTC2946_SimBus : public LTC2946_Bus {
+public:
+    LTC2946_SimBus(LTC2946_SimClock *clock = NULL //! <Clock shared with other buses, or NULL for a private one>
+                  );
+
+    void Attach(LTC2946_SimDevice &device); //! <Put a device on the bus>
+
+    void Begin();
+    int8_t Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len);
+    int8_t Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len);
+    int8_t Receive(uint8_t address, uint8_t *data, uint8_t len);
+
+    bool StartRead(LTC2946_Transfer *xfer);
+    void Poll();
+    bool Busy();
+    uint32_t Micros();
+    void SetTimeout(uint32_t timeout_us);
+    void Delay(uint32_t us);
+    uint32_t SetClock(uint32_t hz);
+    bool BusStuck();
+    bool Recover();
+
+    void Advance(uint32_t us); //! <Advance the simulated clock>
+    bool Alert(); //! <Level of the shared ALERT line: true while any device, run up to now, pulls it low>
+    //! Fastest SCL rate at which the modeled wiring is reliable, 0 (default) for any. Above it, every
+    //! read comes back with one corrupted bit, as marginal edges on a long or heavily loaded bus do.
+    void SetStableClock(uint32_t hz);
+
+    void GetCost(LTC2946_BusCost *cost); //! <Traffic since the last ResetCost()>
+    void ResetCost(); //! <Clear the traffic counters>
+    void HoldSDA(LTC2946_SimDevice &device, //! <Device that gets stuck holding SDA low>
+                 uint8_t clocks             //! <SCL pulses it needs to release SDA, 1 to 9>
+                );
+
+private:
+    LTC2946_SimDevice *devices[LTC2946_SIM_MAX_DEVICES];
+    uint8_t device_count = 0;
+    LTC2946_Transfer *xfer_active = NULL;
+    uint32_t xfer_finish_us = 0; //simulated time the background read completes
+
+    LTC2946_SimClock own_clock;
+    LTC2946_SimClock *clock; //simulated time base, own_clock unless shared
+    uint32_t clock_hz = LTC2946_SIM_CLOCK_HZ;
+    uint32_t timeout_us = 0; //time an injected LTC2946_ERR_TIMEOUT costs, wire time if 0
+    uint32_t stable_hz = 0;  //reads above this SCL rate are corrupted, 0 for never
+    uint32_t corrupt_count = 0; //reads corrupted so far, picks the damaged bit
+    LTC2946_BusCost cost = {0, 0, 0, 0, 0, 0};
+
+    //! Modeled time on the wire for a register access of len data bytes
+    uint32_t WireTime(bool read, uint8_t len);
+    uint32_t BitTime(uint32_t bits); //! <Modeled time for a number of SCL clocks>
+    void Count(bool read, uint8_t len); //! <Book a register access in the traffic counters>
+
+    LTC2946_SimDevice *Find(uint8_t address);
+    uint32_t StuckTime(); //! <Time a transaction on a stuck bus costs before failing>
+    void Drain(); //! <Wait out the background read before a blocking transaction, at most one timeout>
+
+    //! Register map access without bus timing. Returns LTC2946_ERR_ADDR_NACK if no device answers.
+    int8_t WriteRegs(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len);
+    int8_t ReadRegs(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len);
+    void Corrupt(uint8_t *data, uint8_t len); //! <Damage one bit of a read above the stable clock>
+};
+
+#endif  // LTC2946_SIM_H
@@ -0,0 +1,170 @@
+/*!
+LTC2946_Trace: optional timing of every register transaction.
+*/
+
+#include "LTC2946_Trace.h"
+
+#if defined(LTC2946_TRACE)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(ARDUINO)
+#include <chrono>
+#endif
+
+LTC2946_TraceRegister LTC2946_Trace::regs[2][LTC2946_TRACE_REGS];
+uint32_t LTC2946_Trace::histogram[2][LTC2946_TRACE_BUCKETS];
+LTC2946_TraceRecord LTC2946_Trace::ring[LTC2946_TRACE_DEPTH];
+uint32_t LTC2946_Trace::recorded = 0;
+
+void LTC2946_Trace::Begin()
+{
+#if defined(ARDUINO)
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+void LTC2946_Trace::Reset()
+{
+    memset(regs, 0, sizeof(regs));
+    memset(histogram, 0, sizeof(histogram));
+    recorded = 0;
+}
+
+uint32_t LTC2946_Trace::Ticks()
+{
+#if defined(ARDUINO)
+    return(ARM_DWT_CYCCNT);
+#else
+    return((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Cycles on target (wraps after 2^32 / F_CPU seconds), nanoseconds on the host
+uint32_t LTC2946_Trace::TicksToNs(uint32_t ticks)
+{
+#if defined(ARDUINO)
+    return((uint32_t)((uint64_t)ticks * 1000 / (F_CPU / 1000000)));
+#else
+    return(ticks);
+#endif
+}
+
+uint8_t LTC2946_Trace::Bucket(uint32_t ns)
+{
+    uint32_t us = ns / 1000;
+    uint8_t bucket = 0;
+
+    while(us != 0 && bucket < LTC2946_TRACE_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    return(bucket);
+}
+
+void LTC2946_Trace::Record(uint8_t address, uint8_t adc_command, uint8_t len, bool write, int8_t status, uint32_t start_ticks)
+{
+    uint32_t ns = TicksToNs(Ticks() - start_ticks);
+    LTC2946_TraceRecord *record = &ring[recorded % LTC2946_TRACE_DEPTH];
+    LTC2946_TraceRegister *reg;
+
+    if(adc_command < LTC2946_TRACE_REGS)
+    {
+        reg = &regs[write][adc_command];
+        reg->transactions++;
+        reg->bytes += len;
+        reg->total_ns += ns;
+        if(ns > reg->max_ns) reg->max_ns = ns;
+    }
+    histogram[write][Bucket(ns)]++;
+
+    record->address = address;
+    record->adc_command = adc_command;
+    record->len = len;
+    record->write = write;
+    record->status = status;
+    record->ns = ns;
+    recorded++;
+}
+
+const LTC2946_TraceRegister *LTC2946_Trace::Register(uint8_t adc_command, bool write)
+{
+    return(adc_command < LTC2946_TRACE_REGS ? &regs[write][adc_command] : NULL);
+}
+
+const uint32_t *LTC2946_Trace::Histogram(bool write)
+{
+    return(histogram[write]);
+}
+
+// Emit the report line by line through put(), shared by the Print and FILE front ends
+void LTC2946_Trace::Format(void (*put)(void *out, const char *line), void *out)
+{
+    char line[80];
+    uint32_t i, first, count;
+    uint8_t write, reg;
+    const LTC2946_TraceRecord *record;
+
+    put(out, "LTC2946 trace: reg dir count bytes avg_ns max_ns\n");
+    for(write = 0; write < 2; write++)
+    {
+        for(reg = 0; reg < LTC2946_TRACE_REGS; reg++)
+        {
+            if(regs[write][reg].transactions == 0) continue;
+            snprintf(line, sizeof(line), "0x%02X %c %lu %lu %lu %lu\n", reg, write ? 'W' : 'R',
+                     (unsigned long)regs[write][reg].transactions, (unsigned long)regs[write][reg].bytes,
+                     (unsigned long)(regs[write][reg].total_ns / regs[write][reg].transactions),
+                     (unsigned long)regs[write][reg].max_ns);
+            put(out, line);
+        }
+    }
+
+    put(out, "histogram: bucket_us reads writes\n");
+    for(i = 0; i < LTC2946_TRACE_BUCKETS; i++)
+    {
+        if(histogram[0][i] == 0 && histogram[1][i] == 0) continue;
+        snprintf(line, sizeof(line), "%s%lu %lu %lu\n", i == LTC2946_TRACE_BUCKETS - 1 ? ">=" : "<",
+                 i == LTC2946_TRACE_BUCKETS - 1 ? 1UL << (i - 1) : 1UL << i,
+                 (unsigned long)histogram[0][i], (unsigned long)histogram[1][i]);
+        put(out, line);
+    }
+
+    put(out, "recent: addr reg dir len status ns\n");
+    count = recorded < LTC2946_TRACE_DEPTH ? recorded : LTC2946_TRACE_DEPTH;
+    first = recorded - count;
+    for(i = first; i < recorded; i++)
+    {
+        record = &ring[i % LTC2946_TRACE_DEPTH];
+        snprintf(line, sizeof(line), "0x%02X 0x%02X %c %u %d %lu\n", record->address, record->adc_command,
+                 record->write ? 'W' : 'R', record->len, record->status, (unsigned long)record->ns);
+        put(out, line);
+    }
+}
+
+#if defined(ARDUINO)
+static void LTC2946_trace_put(void *out, const char *line)
+{
+    ((Print *)out)->print(line);
+}
+
+void LTC2946_Trace::Dump(Print &out)
+{
+    Format(LTC2946_trace_put, &out);
+}
+#else
+static void LTC2946_trace_put(void *out, const char *line)
+{
+    fputs(line, (FILE *)out);
+}
+
+void LTC2946_Trace::Dump(FILE *out)
+{
+    Format(LTC2946_trace_put, out);
+}
+#endif
+
+#endif  // LTC2946_TRACE
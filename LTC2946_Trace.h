@@ -0,0 +1,100 @@
+/*!
+LTC2946_Trace: optional timing of every register transaction.
+
+Define LTC2946_TRACE (uncomment below, or pass -DLTC2946_TRACE) to time
+each LTC2946 register read and write, retries included. Blocking
+transactions are timed from start to return. Background reads
+(StartRead(), and StartReadBlock() as used by LTC2946_BusManager and
+LTC2946_Acquisition) are timed from the start of the read until IsDone()
+or FinishBlock() collects it, so polling latency is included. Every
+transaction is booked into per-register counters (transactions, bytes,
+total and longest duration), a log2 latency histogram per direction and
+a small ring of the most recent transactions. Dump() prints all of it.
+
+Durations come from the DWT cycle counter on target and from
+std::chrono::steady_clock on the host, and are kept in nanoseconds.
+
+Without LTC2946_TRACE the hooks in LTC2946.cpp expand to nothing and no
+trace storage is linked in.
+*/
+
+#ifndef LTC2946_TRACE_H
+#define LTC2946_TRACE_H
+
+//#define LTC2946_TRACE
+
+#if defined(LTC2946_TRACE)
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stdio.h>
+#endif
+
+#define LTC2946_TRACE_REGS          0x44    //!< Registers tracked, 0x00-0x43
+#define LTC2946_TRACE_BUCKETS       16      //!< Histogram buckets: <1us, then [2^(n-1), 2^n) us, the last one open ended
+#define LTC2946_TRACE_DEPTH         32      //!< Recent transactions kept in the ring
+
+//! One traced transaction
+struct LTC2946_TraceRecord {
+    uint8_t address;        //!< 7-bit I2C address
+    uint8_t adc_command;    //!< First register
+    uint8_t len;            //!< Data bytes
+    bool write;             //!< Write (true) or read (false)
+    int8_t status;          //!< LTC2946_OK or LTC2946_ERR_*
+    uint32_t ns;            //!< Duration, retries and backoff included
+};
+
+//! Counters for one register, as the first register of a transaction
+struct LTC2946_TraceRegister {
+    uint32_t transactions;
+    uint32_t bytes;
+    uint64_t total_ns;      //!< Sum of durations; 32 bits would wrap after about 4.3 s of bus time
+    uint32_t max_ns;
+};
+
+class LTC2946_Trace {
+public:
+    static void Begin(); //! <Start the cycle counter on target. Called from LTC2946::Setup()>
+    static void Reset(); //! <Clear counters, histograms and the ring>
+
+    static uint32_t Ticks(); //! <Free-running timestamp>
+    static void Record(uint8_t address, uint8_t adc_command, uint8_t len, bool write, int8_t status,
+                       uint32_t start_ticks //! <Ticks() when the transaction began>
+                      );
+
+    static const LTC2946_TraceRegister *Register(uint8_t adc_command, bool write); //! <Counters of one register>
+    static const uint32_t *Histogram(bool write); //! <LTC2946_TRACE_BUCKETS bucket counts>
+
+#if defined(ARDUINO)
+    static void Dump(Print &out); //! <Print counters, histograms and recent transactions>
+#else
+    static void Dump(FILE *out); //! <Print counters, histograms and recent transactions>
+#endif
+
+private:
+    static LTC2946_TraceRegister regs[2][LTC2946_TRACE_REGS];
+    static uint32_t histogram[2][LTC2946_TRACE_BUCKETS];
+    static LTC2946_TraceRecord ring[LTC2946_TRACE_DEPTH];
+    static uint32_t recorded; //transactions since Reset(), ring index is recorded % LTC2946_TRACE_DEPTH
+
+    static uint32_t TicksToNs(uint32_t ticks);
+    static uint8_t Bucket(uint32_t ns);
+    static void Format(void (*put)(void *out, const char *line), void *out);
+};
+
+#define LTC2946_TRACE_BEGIN(start)                      uint32_t start = LTC2946_Trace::Ticks()
+#define LTC2946_TRACE_MARK(start)                       start = LTC2946_Trace::Ticks()
+#define LTC2946_TRACE_END(start, addr, cmd, len, write, status) \
+    LTC2946_Trace::Record(addr, cmd, len, write, status, start)
+
+#else
+
+#define LTC2946_TRACE_BEGIN(start)
+#define LTC2946_TRACE_MARK(start)
+#define LTC2946_TRACE_END(start, addr, cmd, len, write, status)
+
+#endif  // LTC2946_TRACE
+
+#endif  // LTC2946_TRACE_H
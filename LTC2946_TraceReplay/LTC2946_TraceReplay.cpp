@@ -0,0 +1,126 @@
+/*!
+LTC2946_TraceReplay: capture and replay bus traces on a Linux host.
+
+    LTC2946_TraceReplay capture <file> [samples]
+        Records measurement-block reads of a simulated device through
+        LTC2946_Capture and writes the trace to file.
+
+    LTC2946_TraceReplay replay <file> [address]
+        Replays a trace (from the field or from capture) into an LTC2946
+        that issues ReadAll() for every measurement block read, and reports
+        divergences and decode throughput against the recorded time span.
+        Traffic other than the device's measurement block reads is stepped
+        over. The address defaults to that of the first record.
+
+Build on Linux from the library directory:
+    cmake -S . -B build && cmake --build build
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "LTC2946_BusTrace.h"
+#include "LTC2946_Sim.h"
+
+#define TRACE_MAX_BYTES     (4UL * 1024 * 1024)
+#define CAPTURE_SAMPLES     1000
+#define CAPTURE_PERIOD_US   1000
+
+static int Capture(const char *file, uint32_t samples)
+{
+    static uint8_t trace[TRACE_MAX_BYTES];
+    LTC2946_SimBus sim_bus;
+    LTC2946_SimDevice sim(0x6F);
+    LTC2946_Capture bus(sim_bus, trace, sizeof(trace));
+    LTC2946 device(bus, 0x6F);
+    LTC2946_Measurement data;
+    uint32_t i;
+    FILE *out;
+
+    sim_bus.Attach(sim);
+    sim.delta_sense_code = 0x200;
+    sim.sense_plus_code = 0x600;
+    device.Setup();
+    device.SetContinuous();
+
+    for(i = 0; i < samples; i++)
+    {
+        sim.delta_sense_code = 0x200 + (i % 64);
+        device.ReadAll(&data);
+        sim_bus.Advance(CAPTURE_PERIOD_US);
+    }
+
+    out = fopen(file, "wb");
+    if(out == NULL || fwrite(bus.Data(), 1, bus.Size(), out) != bus.Size())
+    {
+        fprintf(stderr, "cannot write %s\n", file);
+        return(1);
+    }
+    fclose(out);
+
+    printf("%lu bytes, %lu samples, %lu dropped\n", (unsigned long)bus.Size(), (unsigned long)samples, (unsigned long)bus.Dropped());
+    return(0);
+}
+
+static int Replay(const char *file, int address)
+{
+    static uint8_t trace[TRACE_MAX_BYTES];
+    LTC2946_Measurement data;
+    uint32_t size, samples = 0, span_us;
+    uint8_t op, record_address, adc_command, len;
+    struct timespec start, end;
+    double wall_us;
+    FILE *in;
+
+    in = fopen(file, "rb");
+    if(in == NULL)
+    {
+        fprintf(stderr, "cannot read %s\n", file);
+        return(1);
+    }
+    size = fread(trace, 1, sizeof(trace), in);
+    fclose(in);
+
+    LTC2946_Replay bus(trace, size);
+    if(!bus.Valid())
+    {
+        fprintf(stderr, "%s is not an LTC2946 trace\n", file);
+        return(1);
+    }
+    if(address < 0) address = (size > LTC2946_BUSTRACE_HEADER_LEN + 1) ? trace[LTC2946_BUSTRACE_HEADER_LEN + 1] : 0;
+
+    LTC2946 device(bus, address);
+
+    //Replay the measurement block reads of the device; step over any other traffic
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(bus.Peek(&op, &record_address, &adc_command, &len))
+    {
+        if(op != LTC2946_BUSTRACE_OP_READ || record_address != address ||
+           adc_command != LTC2946_MEAS_BLOCK_START || len != LTC2946_MEAS_BLOCK_LEN)
+        {
+            bus.Skip();
+            continue;
+        }
+
+        device.ReadAll(&data);
+        if(device.LastStatus() == LTC2946_OK) samples++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    wall_us = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+    span_us = bus.Micros();
+    printf("%lu records, %lu samples, %lu divergences\n", (unsigned long)bus.Served(), (unsigned long)samples, (unsigned long)bus.Divergences());
+    printf("trace span %.3f s, replayed in %.3f ms (%.0fx real time, %.0f samples/s)\n",
+           span_us / 1e6, wall_us / 1e3, wall_us > 0 ? span_us / wall_us : 0, wall_us > 0 ? samples * 1e6 / wall_us : 0);
+    return(bus.Divergences() != 0);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc >= 3 && strcmp(argv[1], "capture") == 0) return(Capture(argv[2], argc > 3 ? strtoul(argv[3], NULL, 0) : CAPTURE_SAMPLES));
+    if(argc >= 3 && strcmp(argv[1], "replay") == 0) return(Replay(argv[2], argc > 3 ? (int)strtol(argv[3], NULL, 0) : -1));
+
+    fprintf(stderr, "usage: %s capture <file> [samples] | replay <file> [address]\n", argv[0]);
+    return(2);
+}
@@ -0,0 +1,227 @@
+/*!
+LTC2946_Wire: LTC2946_Bus implementation on top of the Teensy i2c_t3 library.
+*/
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "LTC2946_Wire.h"
+
+//! Shared bus objects, one per Teensy 3.6 I2C peripheral
+static LTC2946_Wire LTC2946_Wire0(Wire);
+static LTC2946_Wire LTC2946_Wire1(Wire1);
+static LTC2946_Wire LTC2946_Wire2(Wire2);
+static LTC2946_Wire LTC2946_Wire3(Wire3);
+
+LTC2946_Wire::LTC2946_Wire(i2c_t3 &wire) : wire(wire) //!constructor
+{
+}
+
+LTC2946_Wire &LTC2946_Wire::Get(uint8_t wire_num)
+{
+    switch(wire_num)
+    {
+        case 1: return(LTC2946_Wire1);
+        case 2: return(LTC2946_Wire2);
+        case 3: return(LTC2946_Wire3);
+        default: return(LTC2946_Wire0);
+    }
+}
+
+void LTC2946_Wire::Begin()
+{
+    wire.begin();
+    if(clock_hz != 0) wire.setClock(clock_hz);
+    if(use_dma) wire.setOpMode(I2C_OP_MODE_DMA);
+}
+
+void LTC2946_Wire::SetDMA(bool state)
+{
+    use_dma = state;
+    wire.setOpMode(state ? I2C_OP_MODE_DMA : I2C_OP_MODE_ISR);
+}
+
+// Write len bytes starting at register adc_command.
+int8_t LTC2946_Wire::Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len)
+// Returns LTC2946_OK or LTC2946_ERR_*
+{
+    Drain();
+
+    wire.beginTransmission(address);
+    wire.write(adc_command);
+
+    wire.write(data, len);
+    return(Status(wire.endTransmission(I2C_NOSTOP, timeout_us)));
+}
+
+// Set the register pointer and read len bytes after a repeated start.
+int8_t LTC2946_Wire::Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len)
+// Returns LTC2946_OK or LTC2946_ERR_*
+{
+    int8_t ack;
+
+    Drain();
+
+    wire.beginTransmission(address);
+    wire.write(adc_command);
+
+    ack = Status(wire.endTransmission(I2C_NOSTOP, timeout_us));
+    if(ack != LTC2946_OK) return(ack);
+
+    wire.requestFrom(address, (size_t)len, I2C_STOP, timeout_us);
+
+    if(wire.read(data, len) < len) return(ReadStatus());
+    return(LTC2946_OK);
+}
+
+// Plain read without a register pointer write
+int8_t LTC2946_Wire::Receive(uint8_t address, uint8_t *data, uint8_t len)
+// Returns LTC2946_OK or LTC2946_ERR_*
+{
+    Drain();
+
+    wire.requestFrom(address, (size_t)len, I2C_STOP, timeout_us);
+
+    if(wire.read(data, len) < len) return(ReadStatus());
+    return(LTC2946_OK);
+}
+
+// Start a background read: register pointer write first, data request issued from Poll() once it completes
+bool LTC2946_Wire::StartRead(LTC2946_Transfer *xfer)
+{
+    if(xfer_state != XFER_IDLE) return(false);
+
+    xfer->done = false;
+    xfer_active = xfer;
+    xfer_state = XFER_POINTER;
+    xfer_start_us = micros();
+    xfer_timeout_us = timeout_us;
+
+    wire.beginTransmission(xfer->address);
+    wire.write(xfer->adc_command);
+    wire.sendTransmission(I2C_NOSTOP);
+
+    return(true);
+}
+
+void LTC2946_Wire::Poll()
+{
+    if(xfer_state == XFER_IDLE) return;
+    if(!wire.done())
+    {
+        //Past its deadline: a slave is stretching the clock or the bus is stuck
+        if(xfer_timeout_us != 0 && micros() - xfer_start_us >= xfer_timeout_us)
+        {
+            Abandon(LTC2946_ERR_TIMEOUT);
+            Reset();
+        }
+        return;
+    }
+
+    if(xfer_state == XFER_POINTER)
+    {
+        xfer_active->ack = Status(wire.getError());
+        if(xfer_active->ack == LTC2946_OK)
+        {
+            //Pointer acknowledged, repeated start into the data phase
+            xfer_state = XFER_DATA;
+            wire.sendRequest(xfer_active->address, xfer_active->len, I2C_STOP);
+            return;
+        }
+    }
+    else
+    {
+        xfer_active->ack = (wire.read(xfer_active->data, xfer_active->len) < xfer_active->len) ? ReadStatus() : LTC2946_OK;
+    }
+
+    xfer_state = XFER_IDLE;
+    xfer_active->done = true;
+}
+
+bool LTC2946_Wire::Busy()
+{
+    return(xfer_state != XFER_IDLE);
+}
+
+uint32_t LTC2946_Wire::Micros()
+{
+    return(micros());
+}
+
+void LTC2946_Wire::SetTimeout(uint32_t timeout_us)
+{
+    this->timeout_us = timeout_us;
+}
+
+void LTC2946_Wire::Delay(uint32_t us)
+{
+    delayMicroseconds(us);
+}
+
+// i2c_t3 picks the nearest rate its dividers allow
+uint32_t LTC2946_Wire::SetClock(uint32_t hz)
+{
+    clock_hz = hz;
+    wire.setClock(hz);
+    return(wire.getClock());
+}
+
+// getSDA()/getSCL() give the pin numbers of the active pin pair; the line levels are read from the pins
+bool LTC2946_Wire::BusStuck()
+{
+    return(digitalReadFast(wire.getSDA()) == LOW && digitalReadFast(wire.getSCL()) == HIGH);
+}
+
+bool LTC2946_Wire::Recover()
+{
+    //Abandon the background read, the transfer cannot complete on a stuck bus
+    Abandon(LTC2946_ERR_OTHER);
+    Reset();
+
+    return(!BusStuck());
+}
+
+void LTC2946_Wire::Drain()
+{
+    uint32_t start = micros();
+
+    while(xfer_state != XFER_IDLE)
+    {
+        Poll();
+        if(xfer_state != XFER_IDLE && timeout_us != 0 && micros() - start >= timeout_us)
+        {
+            Abandon(LTC2946_ERR_TIMEOUT);
+            Reset();
+        }
+    }
+}
+
+void LTC2946_Wire::Abandon(int8_t status)
+{
+    if(xfer_state == XFER_IDLE) return;
+
+    xfer_state = XFER_IDLE;
+    xfer_active->ack = status;
+    xfer_active->done = true;
+}
+
+// i2c_t3 clocks SCL until SDA goes high, sends a STOP and reinitializes the peripheral
+void LTC2946_Wire::Reset()
+{
+    wire.resetBus();
+    if(use_dma) wire.setOpMode(I2C_OP_MODE_DMA);
+}
+
+// Map an i2c_t3 result code to LTC2946_OK/LTC2946_ERR_*. i2c_t3 reports timeouts as "other error".
+int8_t LTC2946_Wire::Status(uint8_t code)
+{
+    if(code != 0 && wire.status() == I2C_TIMEOUT) return(LTC2946_ERR_TIMEOUT);
+    return(code);
+}
+
+// Status of a read that delivered fewer bytes than requested
+int8_t LTC2946_Wire::ReadStatus()
+{
+    int8_t status = Status(wire.getError());
+
+    return(status != LTC2946_OK ? status : LTC2946_ERR_SHORT_READ);
+}
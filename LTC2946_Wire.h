@@ -0,0 +1,69 @@
+/*!
+LTC2946_Wire: LTC2946_Bus implementation on top of the Teensy i2c_t3 library.
+
+Use LTC2946_Wire::Get(n) for the shared bus object of Wire, Wire1, Wire2 or Wire3.
+With SetDMA(true) the bus runs in i2c_t3 DMA mode and received blocks are
+copied out of the i2c_t3 buffer in one call rather than byte by byte.
+
+The timeout bounds each phase of a blocking transaction (register pointer
+write, data read) and the whole of a background read, whose deadline is
+taken from the timeout set when it started. Poll() finishes a background
+read past its deadline with LTC2946_ERR_TIMEOUT and resets the bus, and a
+blocking transaction waits at most one timeout for a background read
+still in flight before doing the same.
+*/
+
+#ifndef LTC2946_WIRE_H
+#define LTC2946_WIRE_H
+
+#include <Arduino.h>
+#include <i2c_t3.h>
+#include "LTC2946_Bus.h"
+
+class LTC2946_Wire : public LTC2946_Bus {
+public:
+    LTC2946_Wire(i2c_t3 &wire //! <i2c_t3 object for this bus (Wire, Wire1, Wire2 or Wire3)>
+                );
+
+    //! Shared bus object for a wire number. For Teensy 3.6, valid values are 0-3.
+    static LTC2946_Wire &Get(uint8_t wire_num);
+
+    void Begin();
+    void SetDMA(bool state); //! <Run transfers on this bus through i2c_t3 DMA mode instead of per-byte ISR handling>
+    int8_t Write(uint8_t address, uint8_t adc_command, const uint8_t *data, uint8_t len);
+    int8_t Read(uint8_t address, uint8_t adc_command, uint8_t *data, uint8_t len);
+    int8_t Receive(uint8_t address, uint8_t *data, uint8_t len);
+
+    bool StartRead(LTC2946_Transfer *xfer);
+    void Poll();
+    bool Busy();
+    uint32_t Micros();
+    void SetTimeout(uint32_t timeout_us);
+    void Delay(uint32_t us);
+    uint32_t SetClock(uint32_t hz);
+    bool BusStuck();
+    bool Recover();
+
+private:
+    i2c_t3 &wire; //stored i2c_t3 object of this bus
+    bool use_dma = false;
+    uint32_t timeout_us = 0; //per-transaction timeout passed to i2c_t3, 0 for none
+    uint32_t clock_hz = 0; //SCL rate set through SetClock(), 0 for the i2c_t3 default
+
+    //Background read state (0=idle, 1=register pointer being sent, 2=data being received)
+    static const uint8_t XFER_IDLE = 0;
+    static const uint8_t XFER_POINTER = 1;
+    static const uint8_t XFER_DATA = 2;
+    volatile uint8_t xfer_state = XFER_IDLE;
+    LTC2946_Transfer *xfer_active = NULL;
+    uint32_t xfer_start_us = 0;     //start of the background read
+    uint32_t xfer_timeout_us = 0;   //its deadline relative to xfer_start_us, 0 for none
+
+    void Drain(); //! <Complete any background read before a blocking transaction, waiting at most one timeout>
+    void Abandon(int8_t status); //! <Finish the background read in flight with status, without the bus>
+    void Reset(); //! <Reinitialize the peripheral, clocking a stuck slave free>
+    int8_t Status(uint8_t code); //! <Map an i2c_t3 result code to LTC2946_OK/LTC2946_ERR_*>
+    int8_t ReadStatus(); //! <Status of a read that delivered fewer bytes than requested>
+};
+
+#endif  // LTC2946_WIRE_H